@@ -0,0 +1,30 @@
+#include "allocation_counter.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Counts the heap allocations of the whole program, so that the benchmarks
+// can report how many of them a diagnostic takes. This is defined out of line
+// from the benchmarks so that no allocation gets inlined into a `free` call.
+static std::atomic<size_t> allocation_count = 0;
+
+auto operator new(std::size_t size) -> void *
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace cci::bench {
+
+auto num_allocations() -> size_t
+{
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+} // namespace cci::bench
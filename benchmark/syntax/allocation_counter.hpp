@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+namespace cci::bench {
+
+/// Returns how many times the global `operator new` has been called so far.
+//
+// The counting replacement of `operator new` lives in allocation_counter.cpp,
+// and only the executables that report allocations link against it.
+auto num_allocations() -> size_t;
+
+} // namespace cci::bench
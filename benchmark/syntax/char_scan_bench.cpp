@@ -0,0 +1,174 @@
+#include "cci/syntax/char_scan.hpp"
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <string>
+
+using cci::syntax::Scanner;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+namespace {
+
+// Generates heavily indented code, which is what machine generated C sources
+// usually look like: deep nesting, alignment padding and blank lines.
+auto make_whitespace_dense_source(size_t num_lines) -> std::string
+{
+    std::string source;
+    for (size_t i = 0; i < num_lines; ++i)
+    {
+        const size_t depth = 4 + (i % 8) * 4;
+        source.append(depth, ' ');
+        source.append("x = y +\t\t\tz ;");
+        source.append(i % 3 == 0 ? "\n\n\n" : "\n");
+    }
+    return source;
+}
+
+template <auto SkipWhitespace>
+void skip_whitespace_runs(benchmark::State &state)
+{
+    const std::string source = make_whitespace_dense_source(10'000);
+    const char *const end = source.data() + source.size();
+
+    for (auto _ : state)
+    {
+        const char *ptr = source.data();
+        while (ptr != end)
+        {
+            ptr = SkipWhitespace(ptr, end);
+            if (ptr != end)
+                ++ptr;
+        }
+        benchmark::DoNotOptimize(ptr);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(source.size()));
+}
+
+void BM_skip_whitespace_scalar(benchmark::State &state)
+{
+    skip_whitespace_runs<cci::syntax::skip_whitespace_scalar>(state);
+}
+BENCHMARK(BM_skip_whitespace_scalar);
+
+void BM_skip_whitespace(benchmark::State &state)
+{
+    skip_whitespace_runs<cci::syntax::skip_whitespace>(state);
+}
+BENCHMARK(BM_skip_whitespace);
+
+void BM_scan_whitespace_dense(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = source_map.create_owned_filemap(
+        "whitespace.c", make_whitespace_dense_source(10'000));
+
+    for (auto _ : state)
+    {
+        Scanner scanner(file, diag);
+        while (scanner.next_token().is_not(TokenKind::eof))
+            ;
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(file.src_view().size()));
+}
+BENCHMARK(BM_scan_whitespace_dense);
+
+// Generates a header in the style of vendored libraries, where license blocks
+// and documentation comments take more space than the declarations.
+auto make_comment_heavy_source(size_t num_decls) -> std::string
+{
+    std::string source =
+        "/*\n"
+        " * Permission is hereby granted, free of charge, to any person\n"
+        " * obtaining a copy of this software and associated documentation\n"
+        " * files (the \"Software\"), to deal in the Software without\n"
+        " * restriction, including without limitation the rights to use,\n"
+        " * copy, modify, merge, publish, distribute, sublicense, and/or sell\n"
+        " * copies of the Software.\n"
+        " */\n";
+    for (size_t i = 0; i < num_decls; ++i)
+    {
+        source.append("/**\n"
+                      " * \\brief Computes the thing from the other thing.\n"
+                      " *\n"
+                      " * \\param ctx The context in which things are done.\n"
+                      " * \\return Zero on success, an error code otherwise.\n"
+                      " */\n"
+                      "int compute(struct context *ctx); // Thread-safe.\n");
+    }
+    return source;
+}
+
+template <auto FindStop>
+void find_comment_stops(benchmark::State &state)
+{
+    const std::string source = make_comment_heavy_source(1'000);
+    const char *const end = source.data() + source.size();
+
+    for (auto _ : state)
+    {
+        const char *ptr = source.data();
+        while (ptr != end)
+        {
+            ptr = FindStop(ptr, end);
+            if (ptr != end)
+                ++ptr;
+        }
+        benchmark::DoNotOptimize(ptr);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(source.size()));
+}
+
+void BM_find_block_comment_stop_scalar(benchmark::State &state)
+{
+    find_comment_stops<cci::syntax::find_block_comment_stop_scalar>(state);
+}
+BENCHMARK(BM_find_block_comment_stop_scalar);
+
+void BM_find_block_comment_stop(benchmark::State &state)
+{
+    find_comment_stops<cci::syntax::find_block_comment_stop>(state);
+}
+BENCHMARK(BM_find_block_comment_stop);
+
+void BM_find_line_comment_stop_scalar(benchmark::State &state)
+{
+    find_comment_stops<cci::syntax::find_line_comment_stop_scalar>(state);
+}
+BENCHMARK(BM_find_line_comment_stop_scalar);
+
+void BM_find_line_comment_stop(benchmark::State &state)
+{
+    find_comment_stops<cci::syntax::find_line_comment_stop>(state);
+}
+BENCHMARK(BM_find_line_comment_stop);
+
+void BM_scan_comment_heavy(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = source_map.create_owned_filemap(
+        "comments.h", make_comment_heavy_source(1'000));
+
+    for (auto _ : state)
+    {
+        Scanner scanner(file, diag);
+        while (scanner.next_token().is_not(TokenKind::eof))
+            ;
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(file.src_view().size()));
+}
+BENCHMARK(BM_scan_comment_heavy);
+
+} // namespace
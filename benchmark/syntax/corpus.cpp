@@ -0,0 +1,271 @@
+#include "corpus.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace cci::bench {
+
+namespace {
+
+/// A source of random choices that behaves the same on every platform.
+struct Random
+{
+private:
+    std::mt19937 engine;
+
+public:
+    explicit Random(uint32_t seed) : engine(seed) {}
+
+    /// Returns a number in `[0, n)`. The modulo bias doesn't matter here.
+    auto below(size_t n) -> size_t { return engine() % n; }
+
+    /// Returns whether a one in `n` chance happened.
+    auto one_in(size_t n) -> bool { return below(n) == 0; }
+
+    /// Returns a random element of `items`.
+    template <typename T, size_t N>
+    auto pick(const T (&items)[N]) -> const T &
+    {
+        return items[below(N)];
+    }
+};
+
+constexpr const char *words[] = {
+    "node",   "value", "index", "buffer", "count",  "offset", "length",
+    "parent", "child", "left",  "right",  "result", "state",  "context",
+    "entry",  "table", "key",   "hash",   "next",   "prev",   "data",
+};
+
+constexpr const char *types[] = {
+    "int", "unsigned long", "const char *", "struct tree_node *", "size_t",
+    "double", "_Bool", "signed char",
+};
+
+auto identifier(Random &rand) -> std::string
+{
+    std::string id(rand.pick(words));
+    for (size_t n = rand.below(3); n != 0; --n)
+    {
+        id += '_';
+        id += rand.pick(words);
+    }
+    if (rand.one_in(3))
+        id += std::to_string(rand.below(100));
+    return id;
+}
+
+void append_identifiers_line(Random &rand, std::string &out)
+{
+    switch (rand.below(3))
+    {
+        case 0:
+            out += "static inline ";
+            out += rand.pick(types);
+            out += ' ' + identifier(rand) + '(' + rand.pick(types) + ' ' +
+                   identifier(rand) + ", " + rand.pick(types) + ' ' +
+                   identifier(rand) + ");\n";
+            break;
+        case 1:
+            out += "    " + identifier(rand) + "->" + identifier(rand) +
+                   " = " + identifier(rand) + '[' + identifier(rand) +
+                   "] + " + identifier(rand) + ";\n";
+            break;
+        default:
+            out += "    if (" + identifier(rand) + " != " + identifier(rand) +
+                   " && !" + identifier(rand) + ") return " +
+                   identifier(rand) + ";\n";
+            break;
+    }
+}
+
+auto number(Random &rand) -> std::string
+{
+    constexpr const char *int_suffixes[] = {"", "", "u", "l", "ul", "ll",
+                                                 "ULL"};
+    constexpr const char *float_suffixes[] = {"", "f", "L"};
+    const auto digits = std::to_string(rand.below(4'000'000'000));
+    switch (rand.below(5))
+    {
+        case 0: return digits + std::string(rand.pick(int_suffixes));
+        case 1:
+        {
+            constexpr char hex[] = "0123456789abcdefABCDEF";
+            std::string n = "0x";
+            for (size_t i = 1 + rand.below(16); i != 0; --i)
+                n += hex[rand.below(sizeof(hex) - 1)];
+            return n + std::string(rand.pick(int_suffixes));
+        }
+        case 2:
+        {
+            std::string n = "0";
+            for (size_t i = 1 + rand.below(11); i != 0; --i)
+                n += static_cast<char>('0' + rand.below(8));
+            return n + 'u';
+        }
+        case 3:
+            return digits + '.' + std::to_string(rand.below(1'000'000)) +
+                   std::string(rand.pick(float_suffixes));
+        default:
+            return std::to_string(rand.below(10)) + '.' +
+                   std::to_string(rand.below(100'000)) + 'e' +
+                   (rand.one_in(2) ? '-' : '+') +
+                   std::to_string(rand.below(300)) +
+                   std::string(rand.pick(float_suffixes));
+    }
+}
+
+void append_numbers_line(Random &rand, std::string &out)
+{
+    out += "    {";
+    for (size_t i = 0; i < 8; ++i)
+        out += (i == 0 ? "" : ", ") + number(rand);
+    out += "},\n";
+}
+
+void append_strings_line(Random &rand, std::string &out)
+{
+    constexpr const char *prefixes[] = {"", "", "", "L", "u8", "u", "U"};
+    constexpr const char *pieces[] = {
+        "value of ", "%s", " is %d", "\\n", "\\t", "\\\"quoted\\\"", "\\\\",
+        "\\x41", "\\101", "path/to/file.c", ": error: ", "%zu bytes",
+    };
+    constexpr const char *chars[] = {"'a'", "'\\n'", "'\\''", "'\\0'",
+                                          "L'x'", "'\\x7f'"};
+
+    out += "    " + identifier(rand) + '(';
+    out += rand.pick(prefixes);
+    out += '"';
+    for (size_t n = 1 + rand.below(6); n != 0; --n)
+        out += rand.pick(pieces);
+    out += '"';
+    if (rand.one_in(3))
+        out += " \"" + identifier(rand) + '"';
+    out += ", ";
+    out += rand.pick(chars);
+    out += ");\n";
+}
+
+void append_comments_line(Random &rand, std::string &out)
+{
+    const auto prose = [&](size_t num_words) {
+        std::string text;
+        for (size_t i = 0; i < num_words; ++i)
+        {
+            text += ' ';
+            text += rand.pick(words);
+        }
+        return text;
+    };
+
+    switch (rand.below(4))
+    {
+        case 0:
+            out += "/**\n";
+            for (size_t n = 1 + rand.below(6); n != 0; --n)
+                out += " *" + prose(4 + rand.below(8)) + '\n';
+            out += " */\n";
+            break;
+        case 1: out += "//" + prose(3 + rand.below(10)) + '\n'; break;
+        case 2: out += "/*" + prose(2 + rand.below(4)) + " */\n"; break;
+        default:
+            out += "extern " + std::string(rand.pick(types)) + ' ' +
+                   identifier(rand) + "; //" + prose(3) + '\n';
+            break;
+    }
+}
+
+auto unicode_identifier(Random &rand) -> std::string
+{
+    // UTF-8 encoded characters, and the same characters spelled as UCNs.
+    constexpr const char *pieces[] = {
+        "caf\u00e9", "na\u00efve", "\u03bb",       "\u65e5\u672c",
+        "\u00c0",    "\\u00C0",   "\\u03bb",     "\\U0001F600",
+        "x",
+    };
+    std::string id = rand.one_in(2) ? "" : std::string(rand.pick(words));
+    for (size_t n = 1 + rand.below(3); n != 0; --n)
+        id += rand.pick(pieces);
+    return id;
+}
+
+void append_unicode_line(Random &rand, std::string &out)
+{
+    out += "    " + unicode_identifier(rand) + " = " +
+           unicode_identifier(rand) + " + " + unicode_identifier(rand) +
+           ";\n";
+}
+
+void append_splices_line(Random &rand, std::string &out)
+{
+    constexpr const char *splices[] = {"\\\n", "\?\?/\n"};
+    constexpr const char *trigraphs[] = {"\?\?(", "\?\?)", "\?\?<",
+                                              "\?\?>", "\?\?!", "\?\?'",
+                                              "\?\?-", "\?\?="};
+
+    // Splits an identifier and a string literal in the middle.
+    const std::string id = identifier(rand);
+    const size_t split = 1 + rand.below(id.size() - 1);
+    out += "    " + id.substr(0, split);
+    out += rand.pick(splices);
+    out += id.substr(split);
+    out += ' ';
+    out += rand.pick(trigraphs);
+    out += " \"split";
+    out += rand.pick(splices);
+    out += "string\" ";
+    out += rand.pick(trigraphs);
+    out += ' ' + identifier(rand) + ";\n";
+}
+
+} // namespace
+
+auto corpus_kind_name(CorpusKind kind) -> std::string_view
+{
+    switch (kind)
+    {
+        case CorpusKind::identifiers: return "identifiers";
+        case CorpusKind::numbers: return "numbers";
+        case CorpusKind::strings: return "strings";
+        case CorpusKind::comments: return "comments";
+        case CorpusKind::unicode: return "unicode";
+        case CorpusKind::splices: return "splices";
+    }
+    return "";
+}
+
+auto parse_corpus_kind(std::string_view name) -> std::optional<CorpusKind>
+{
+    for (const CorpusKind kind : corpus_kinds)
+    {
+        if (corpus_kind_name(kind) == name)
+            return kind;
+    }
+    return std::nullopt;
+}
+
+auto generate_corpus(CorpusKind kind, size_t min_size, uint32_t seed)
+    -> std::string
+{
+    Random rand(seed);
+    std::string out;
+    out.reserve(min_size + 256);
+    while (out.size() < min_size)
+    {
+        switch (kind)
+        {
+            case CorpusKind::identifiers:
+                append_identifiers_line(rand, out);
+                break;
+            case CorpusKind::numbers: append_numbers_line(rand, out); break;
+            case CorpusKind::strings: append_strings_line(rand, out); break;
+            case CorpusKind::comments: append_comments_line(rand, out); break;
+            case CorpusKind::unicode: append_unicode_line(rand, out); break;
+            case CorpusKind::splices: append_splices_line(rand, out); break;
+        }
+    }
+    return out;
+}
+
+} // namespace cci::bench
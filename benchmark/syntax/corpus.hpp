@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cci::bench {
+
+/// The kinds of synthetic sources the scanner benchmarks run on, each of
+/// which stresses a different part of the scanner.
+enum class CorpusKind
+{
+    identifiers, ///< Declarations and expressions, mostly identifiers.
+    numbers,     ///< Tables of integer and floating constants.
+    strings,     ///< Calls taking string literals and character constants.
+    comments,    ///< Headers that are mostly block and line comments.
+    unicode,     ///< Identifiers with UCNs and UTF-8 characters.
+    splices,     ///< Trigraphs and escaped newlines all over the place.
+};
+
+/// All corpus kinds, in declaration order.
+inline constexpr CorpusKind corpus_kinds[] = {
+    CorpusKind::identifiers, CorpusKind::numbers, CorpusKind::strings,
+    CorpusKind::comments,    CorpusKind::unicode, CorpusKind::splices,
+};
+
+/// Returns the name of a corpus kind, as accepted by `parse_corpus_kind`.
+auto corpus_kind_name(CorpusKind kind) -> std::string_view;
+
+/// Returns the corpus kind named `name`, or nothing if there's none.
+auto parse_corpus_kind(std::string_view name) -> std::optional<CorpusKind>;
+
+/// Generates a lexically valid C source of at least `min_size` bytes.
+//
+/// The output only depends on the arguments: the random engine is fully
+/// specified by the standard, and no standard distributions are used, as
+/// those aren't. The same corpus can thus be written out with `cci_corpus`
+/// and measured elsewhere.
+///
+/// \param kind The kind of source to generate.
+/// \param min_size The size the source is grown to, in whole lines.
+/// \param seed The seed of the random engine.
+auto generate_corpus(CorpusKind kind, size_t min_size, uint32_t seed = 1)
+    -> std::string;
+
+} // namespace cci::bench
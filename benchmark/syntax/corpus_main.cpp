@@ -0,0 +1,41 @@
+#include "corpus.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+
+// Writes one of the generated scanner benchmark corpora to the standard
+// output, so that it can be kept around or fed to other tools.
+//
+// Usage: cci_corpus <kind> [size-in-bytes] [seed]
+int main(int argc, char **argv)
+{
+    const auto kind =
+        argc >= 2 ? cci::bench::parse_corpus_kind(argv[1]) : std::nullopt;
+    if (!kind || argc > 4)
+    {
+        std::fprintf(stderr, "usage: %s <kind> [size-in-bytes] [seed]\n",
+                     argv[0]);
+        std::fprintf(stderr, "kinds:");
+        for (const auto k : cci::bench::corpus_kinds)
+        {
+            const auto name = cci::bench::corpus_kind_name(k);
+            std::fprintf(stderr, " %.*s", static_cast<int>(name.size()),
+                         name.data());
+        }
+        std::fprintf(stderr, "\n");
+        return EXIT_FAILURE;
+    }
+
+    const size_t size = argc >= 3 ? std::strtoull(argv[2], nullptr, 10)
+                                  : size_t{4} << 20;
+    const auto seed = argc >= 4 ? static_cast<uint32_t>(
+                                      std::strtoul(argv[3], nullptr, 10))
+                                : uint32_t{1};
+
+    const std::string corpus = cci::bench::generate_corpus(*kind, size, seed);
+    const bool written = std::fwrite(corpus.data(), 1, corpus.size(),
+                                     stdout) == corpus.size();
+    return written && std::fflush(stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
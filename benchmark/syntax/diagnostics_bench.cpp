@@ -0,0 +1,321 @@
+#include "allocation_counter.hpp"
+#include "cci/syntax/concurrent_handler.hpp"
+#include "cci/syntax/diagnostic_stream.hpp"
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/diagnostics_new.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "benchmark/benchmark.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using cci::bench::num_allocations;
+using cci::syntax::ByteLoc;
+using cci::syntax::ByteSpan;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+namespace {
+
+// Reports diagnostics the way the parser does on broken code: each with a
+// couple of arguments and a source range. The emitter only counts them, like
+// a driver that stops after too many errors would.
+void BM_report_diagnostics(benchmark::State &state)
+{
+    SourceMap source_map;
+    std::string source;
+    for (size_t i = 0; i < 10'000; ++i)
+        source.append("int x = (y + ;\n");
+    const auto &file =
+        source_map.create_owned_filemap("broken.c", std::move(source));
+
+    size_t num_emitted = 0;
+    cci::diag::Handler diag(
+        [&](const cci::diag::Diagnostic &) { ++num_emitted; }, source_map);
+
+    std::vector<ByteLoc> locs;
+    for (size_t i = 0; i < 10'000; ++i)
+        locs.push_back(file.start_loc + ByteLoc(15 * i + 13));
+
+    const size_t allocations_before = num_allocations();
+    for (auto _ : state)
+    {
+        for (const ByteLoc loc : locs)
+        {
+            diag.report(loc, cci::diag::Diag::expected_but_got)
+                .args(TokenKind::r_paren, TokenKind::semi)
+                .ranges({ByteSpan(loc - ByteLoc(4), loc)});
+        }
+    }
+    const size_t num_reported =
+        static_cast<size_t>(state.iterations()) * locs.size();
+
+    benchmark::DoNotOptimize(num_emitted);
+    state.SetItemsProcessed(static_cast<int64_t>(num_reported));
+    state.counters["allocs_per_diag"] =
+        static_cast<double>(num_allocations() - allocations_before) /
+        static_cast<double>(num_reported);
+}
+BENCHMARK(BM_report_diagnostics);
+
+// Same as above, but each of `state.range(0)` threads reports its share of the
+// diagnostics through a `ConcurrentHandler`, whose queues are drained and
+// sorted once all threads are done.
+void BM_report_diagnostics_concurrent(benchmark::State &state)
+{
+    const auto num_threads = static_cast<size_t>(state.range(0));
+    SourceMap source_map;
+    std::string source;
+    for (size_t i = 0; i < 10'000; ++i)
+        source.append("int x = (y + ;\n");
+    const auto &file =
+        source_map.create_owned_filemap("broken.c", std::move(source));
+
+    size_t num_emitted = 0;
+    cci::diag::ConcurrentHandler handler(
+        [&](const cci::diag::Diagnostic &) { ++num_emitted; });
+
+    const size_t allocations_before = num_allocations();
+    for (auto _ : state)
+    {
+        {
+            std::vector<std::jthread> threads;
+            for (size_t t = 0; t < num_threads; ++t)
+            {
+                threads.emplace_back([&, t] {
+                    cci::diag::Handler diag(handler.make_emitter(0),
+                                            source_map);
+                    for (size_t i = t; i < 10'000; i += num_threads)
+                    {
+                        const ByteLoc loc = file.start_loc + ByteLoc(15 * i);
+                        diag.report(loc, cci::diag::Diag::expected_but_got)
+                            .args(TokenKind::r_paren, TokenKind::semi)
+                            .ranges({ByteSpan(loc, loc + ByteLoc(4))});
+                    }
+                });
+            }
+        }
+        handler.emit_all();
+    }
+    const size_t num_reported =
+        static_cast<size_t>(state.iterations()) * 10'000;
+
+    benchmark::DoNotOptimize(num_emitted);
+    state.SetItemsProcessed(static_cast<int64_t>(num_reported));
+    state.counters["allocs_per_diag"] =
+        static_cast<double>(num_allocations() - allocations_before) /
+        static_cast<double>(num_reported);
+}
+BENCHMARK(BM_report_diagnostics_concurrent)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+
+// Resolves the locations of diagnostics spread over a large file, the way an
+// emitter printing them would: one at a time, or all at once.
+void BM_resolve_diagnostic_locations(benchmark::State &state)
+{
+    const bool batch = state.range(0) != 0;
+    SourceMap source_map;
+    std::string source;
+    for (size_t i = 0; i < 100'000; ++i)
+        source.append(i % 10 == 0 ? "\xce\xb1 = (y + ;\n" : "int x = (y + ;\n");
+    const auto &file =
+        source_map.create_owned_filemap("broken.c", std::move(source));
+
+    std::vector<ByteLoc> locs;
+    const auto text = file.src_view();
+    for (size_t i = text.find(';'); i != text.npos; i = text.find(';', i + 1))
+    {
+        if (i % 97 < 10)
+            locs.push_back(file.start_loc + ByteLoc(i));
+    }
+
+    size_t sum = 0;
+    for (auto _ : state)
+    {
+        if (batch)
+        {
+            for (const auto &loc : source_map.lookup_source_locations(locs))
+                sum += loc.line + static_cast<size_t>(loc.column);
+        }
+        else
+        {
+            for (const ByteLoc loc : locs)
+            {
+                const auto sl = source_map.lookup_source_location(loc);
+                sum += sl.line + static_cast<size_t>(sl.column);
+            }
+        }
+    }
+
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(locs.size()));
+    state.counters["locs"] = static_cast<double>(locs.size());
+}
+BENCHMARK(BM_resolve_diagnostic_locations)->ArgName("batch")->Arg(0)->Arg(1);
+
+constexpr cci::diag2::DiagnosticDescriptor redefinition{
+    .message = "redefinition of '{name}' as a {kind} at line {line}",
+    .params =
+        {
+            cci::diag2::DiagnosticParam("name",
+                                        cci::diag2::DiagnosticParamKind::Str),
+            cci::diag2::DiagnosticParam(
+                "kind", cci::diag2::DiagnosticParamKind::TokenKind),
+            cci::diag2::DiagnosticParam("line",
+                                        cci::diag2::DiagnosticParamKind::Int),
+        },
+};
+
+// Builds a diagnostic with a few arguments of each kind, whose string
+// argument is longer than what fits in a small string.
+void BM_build_diag2_diagnostics(benchmark::State &state)
+{
+    const std::string name = "symbol_table_entry";
+    const size_t allocations_before = num_allocations();
+    for (auto _ : state)
+    {
+        auto diag = cci::diag2::DiagnosticBuilder<redefinition>()
+                        .caret_at(ByteLoc(42))
+                        .with_arg("name", name)
+                        .with_arg("kind", TokenKind::kw_struct)
+                        .with_arg("line", 7)
+                        .build();
+        benchmark::DoNotOptimize(diag);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.counters["allocs_per_diag"] =
+        static_cast<double>(num_allocations() - allocations_before) /
+        static_cast<double>(state.iterations());
+}
+BENCHMARK(BM_build_diag2_diagnostics);
+
+constexpr const cci::diag2::DiagnosticDescriptor *catalog[] = {&redefinition};
+
+// A source with a redefinition on every other line, and a bag with a
+// diagnostic for each of them, whose name arguments refer to the source.
+struct RedefinitionsFixture
+{
+    SourceMap source_map;
+    cci::diag2::DiagnosticBag bag;
+
+    RedefinitionsFixture()
+    {
+        std::string source;
+        for (size_t i = 0; i < 5'000; ++i)
+        {
+            const auto name = "symbol_" + std::to_string(i);
+            source += "int " + name + ";\nstruct " + name + " *p;\n";
+        }
+        const auto &file =
+            source_map.create_owned_filemap("redefinitions.c", source);
+
+        const std::string_view text = file.src_view();
+        size_t line = 1;
+        for (size_t pos = text.find("struct"); pos != text.npos;
+             pos = text.find("struct", pos + 1))
+        {
+            const size_t name_pos = pos + 7;
+            const auto name =
+                text.substr(name_pos, text.find(' ', name_pos) - name_pos);
+            const ByteLoc loc = file.start_loc + ByteLoc(name_pos);
+            bag.add(cci::diag2::DiagnosticBuilder<redefinition>()
+                        .caret_at(loc)
+                        .with_span(ByteSpan(loc, loc + ByteLoc(name.size())))
+                        .with_arg("name", name)
+                        .with_arg("kind", TokenKind::kw_struct)
+                        .with_arg("line", static_cast<int>(line))
+                        .build());
+            line += 2;
+        }
+    }
+};
+
+void report_allocations(benchmark::State &state, size_t allocations_before,
+                        size_t num_diags)
+{
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_diags));
+    state.counters["allocs_per_diag"] =
+        static_cast<double>(num_allocations() - allocations_before) /
+        static_cast<double>(static_cast<size_t>(state.iterations()) *
+                            num_diags);
+}
+
+// Renders all diagnostics of the bag as text lines, as a compiler printing
+// them would, into a buffer that's reused across iterations.
+void BM_render_diag2_text(benchmark::State &state)
+{
+    RedefinitionsFixture fixture;
+    std::string text;
+    const size_t allocations_before = num_allocations();
+    for (auto _ : state)
+    {
+        text.clear();
+        for (const auto &diag : fixture.bag)
+            cci::diag2::render_text(diag, fixture.source_map, text);
+        benchmark::DoNotOptimize(text.data());
+    }
+    report_allocations(state, allocations_before, fixture.bag.size());
+    state.counters["bytes_per_diag"] = static_cast<double>(text.size()) /
+                                       static_cast<double>(fixture.bag.size());
+}
+BENCHMARK(BM_render_diag2_text);
+
+// Serializes all diagnostics of the bag into a binary stream.
+void BM_write_diag2_binary(benchmark::State &state)
+{
+    RedefinitionsFixture fixture;
+    size_t stream_size = 0;
+    const size_t allocations_before = num_allocations();
+    for (auto _ : state)
+    {
+        cci::diag2::DiagnosticWriter writer(fixture.source_map, catalog);
+        writer.write(fixture.bag);
+        stream_size = static_cast<size_t>(writer.data().size());
+        benchmark::DoNotOptimize(writer.data().data());
+    }
+    report_allocations(state, allocations_before, fixture.bag.size());
+    state.counters["bytes_per_diag"] = static_cast<double>(stream_size) /
+                                       static_cast<double>(fixture.bag.size());
+}
+BENCHMARK(BM_write_diag2_binary);
+
+// Reads all diagnostics back from a binary stream, only looking at their
+// descriptors and carets, or also rendering them as text.
+void BM_read_diag2_binary(benchmark::State &state)
+{
+    const bool render = state.range(0) != 0;
+    RedefinitionsFixture fixture;
+    cci::diag2::DiagnosticWriter writer(fixture.source_map, catalog);
+    writer.write(fixture.bag);
+
+    std::string text;
+    size_t lines = 0;
+    const size_t allocations_before = num_allocations();
+    for (auto _ : state)
+    {
+        text.clear();
+        cci::diag2::DiagnosticReader reader(writer.data(), catalog);
+        while (const auto record = reader.next())
+        {
+            if (render)
+                record->render(text);
+            else
+                lines += record->caret->line;
+        }
+        benchmark::DoNotOptimize(text.data());
+    }
+    benchmark::DoNotOptimize(lines);
+    report_allocations(state, allocations_before, fixture.bag.size());
+}
+BENCHMARK(BM_read_diag2_binary)->ArgName("render")->Arg(0)->Arg(1);
+
+} // namespace
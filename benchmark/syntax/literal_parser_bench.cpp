@@ -0,0 +1,137 @@
+#include "corpus.hpp"
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/literal_parser.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using cci::bench::CorpusKind;
+using cci::syntax::ByteLoc;
+using cci::syntax::FileMap;
+using cci::syntax::NumericConstantParser;
+using cci::syntax::Scanner;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+namespace {
+
+// Returns the spelling and location of the numeric constants in the numbers
+// corpus, which mixes decimal, hexadecimal and octal integer constants of up
+// to 16 digits, and decimal floating constants of up to 16 digits.
+auto numeric_constants(Scanner &scanner, bool floating)
+    -> std::vector<std::pair<std::string_view, ByteLoc>>
+{
+    std::vector<std::pair<std::string_view, ByteLoc>> literals;
+    for (auto tok = scanner.next_token(); tok.is_not(TokenKind::eof);
+         tok = scanner.next_token())
+    {
+        if (tok.is(TokenKind::numeric_constant))
+        {
+            const auto spelling = scanner.source_text(tok);
+            const bool is_floating =
+                !spelling.starts_with("0x") &&
+                spelling.find_first_of(".eE") != std::string_view::npos;
+            if (is_floating == floating)
+                literals.emplace_back(spelling, tok.location());
+        }
+    }
+    return literals;
+}
+
+auto numbers_corpus(SourceMap &source_map) -> const FileMap &
+{
+    return source_map.create_owned_filemap(
+        "numbers.c",
+        cci::bench::generate_corpus(CorpusKind::numbers, 1 << 20));
+}
+
+// Parses and evaluates every integer constant of the numbers corpus.
+template <bool Scalar>
+void BM_numeric_constant_to_integer(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    Scanner scanner(numbers_corpus(source_map), diag);
+    const auto literals = numeric_constants(scanner, false);
+
+    for (auto _ : state)
+    {
+        uint64_t sum = 0;
+        for (const auto &[spelling, loc] : literals)
+        {
+            NumericConstantParser parser(scanner, spelling, loc);
+            const auto [value, overflowed] =
+                Scalar ? parser.to_integer_scalar() : parser.to_integer();
+            sum += value + overflowed;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(literals.size()));
+}
+
+BENCHMARK_TEMPLATE(BM_numeric_constant_to_integer, false);
+BENCHMARK_TEMPLATE(BM_numeric_constant_to_integer, true);
+
+// Parses and evaluates every floating constant of the numbers corpus.
+void BM_numeric_constant_to_double(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    Scanner scanner(numbers_corpus(source_map), diag);
+    const auto literals = numeric_constants(scanner, true);
+
+    for (auto _ : state)
+    {
+        double sum = 0;
+        for (const auto &[spelling, loc] : literals)
+        {
+            NumericConstantParser parser(scanner, spelling, loc);
+            sum += parser.to_double().first;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(literals.size()));
+}
+
+BENCHMARK(BM_numeric_constant_to_double);
+
+// Baseline: the same floating constants converted by the C library.
+void BM_strtod(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    Scanner scanner(numbers_corpus(source_map), diag);
+
+    // strtod needs null-terminated strings, and chokes on suffixes.
+    std::vector<std::string> literals;
+    for (const auto &[spelling, loc] : numeric_constants(scanner, true))
+    {
+        literals.emplace_back(spelling.substr(
+            0, spelling.find_last_of("0123456789") + 1));
+    }
+
+    for (auto _ : state)
+    {
+        double sum = 0;
+        for (const std::string &literal : literals)
+            sum += std::strtod(literal.c_str(), nullptr);
+        benchmark::DoNotOptimize(sum);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(literals.size()));
+}
+
+BENCHMARK(BM_strtod);
+
+} // namespace
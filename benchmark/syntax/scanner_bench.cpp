@@ -0,0 +1,111 @@
+#include "corpus.hpp"
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/util/filesystem.hpp"
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using cci::bench::CorpusKind;
+using cci::syntax::FileMap;
+using cci::syntax::Scanner;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+// Throughput of `Scanner::next_token` on sources that each stress a different
+// part of the scanner, see `CorpusKind`. The corpora are generated from a
+// fixed seed, so the numbers can be compared across machines and commits, and
+// `cci_corpus` writes the very same sources to files.
+//
+// Setting `CCI_BENCH_CORPUS` to a directory also measures the scanner on every
+// C source and header in it, recursively.
+
+namespace {
+
+constexpr size_t corpus_size = 4 << 20;
+
+// Scans all of `files` in every iteration, and reports bytes and tokens per
+// second, as well as the number of lexical errors, which should be zero for
+// the generated corpora.
+void scan_files(benchmark::State &state, const SourceMap &source_map,
+                const std::vector<const FileMap *> &files)
+{
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    size_t num_bytes = 0;
+    size_t num_tokens = 0;
+
+    for (auto _ : state)
+    {
+        num_bytes = 0;
+        num_tokens = 0;
+        for (const FileMap *file : files)
+        {
+            Scanner scanner(*file, diag);
+            while (scanner.next_token().is_not(TokenKind::eof))
+                ++num_tokens;
+            num_bytes += file->src_view().size();
+        }
+        benchmark::DoNotOptimize(num_tokens);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_bytes));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_tokens));
+    state.counters["errors"] = static_cast<double>(
+        diag.err_count() / std::max<size_t>(1, state.iterations()));
+}
+
+void BM_scan_corpus(benchmark::State &state, CorpusKind kind)
+{
+    SourceMap source_map;
+    const FileMap &file = source_map.create_owned_filemap(
+        std::string(cci::bench::corpus_kind_name(kind)) + ".c",
+        cci::bench::generate_corpus(kind, corpus_size));
+    scan_files(state, source_map, {&file});
+}
+
+void BM_scan_corpus_dir(benchmark::State &state, const fs::path &dir)
+{
+    SourceMap source_map;
+    std::vector<fs::path> paths;
+    for (const auto &entry : fs::recursive_directory_iterator(dir))
+    {
+        const auto ext = entry.path().extension();
+        if (entry.is_regular_file() && (ext == ".c" || ext == ".h"))
+            paths.push_back(entry.path());
+    }
+
+    std::vector<const FileMap *> files;
+    for (const FileMap *file : source_map.load_filemaps(paths))
+    {
+        if (file)
+            files.push_back(file);
+    }
+    state.counters["files"] = static_cast<double>(files.size());
+    scan_files(state, source_map, files);
+}
+
+const bool registered = [] {
+    for (const CorpusKind kind : cci::bench::corpus_kinds)
+    {
+        const auto name = "BM_scan_corpus/" +
+                          std::string(cci::bench::corpus_kind_name(kind));
+        benchmark::RegisterBenchmark(name.c_str(), BM_scan_corpus, kind);
+    }
+
+    if (const char *dir = std::getenv("CCI_BENCH_CORPUS"))
+    {
+        benchmark::RegisterBenchmark("BM_scan_corpus_dir", BM_scan_corpus_dir,
+                                     fs::path(dir))
+            ->Unit(benchmark::kMillisecond);
+    }
+    return true;
+}();
+
+} // namespace
@@ -0,0 +1,135 @@
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using cci::syntax::ByteLoc;
+using cci::syntax::ByteSpan;
+using cci::syntax::Scanner;
+using cci::syntax::SourceMap;
+using cci::syntax::Token;
+using cci::syntax::TokenKind;
+
+// These benchmarks measure what the width of source locations costs. Build
+// once as is and once with `-DCCI_WIDE_SOURCE_LOCATIONS=YES` to compare. Each
+// one reports the sizes of the location types as counters.
+
+namespace {
+
+void report_sizes(benchmark::State &state)
+{
+    state.counters["sizeof_ByteLoc"] = sizeof(ByteLoc);
+    state.counters["sizeof_ByteSpan"] = sizeof(ByteSpan);
+    state.counters["sizeof_Token"] = sizeof(Token);
+}
+
+auto make_statements(size_t num_lines) -> std::string
+{
+    std::string source;
+    for (size_t i = 0; i < num_lines; ++i)
+    {
+        source.append("    total += values[" + std::to_string(i % 97) +
+                      "] * (scale - 1) / 3;\n");
+    }
+    return source;
+}
+
+auto lex_all(const cci::syntax::FileMap &file, cci::diag::Handler &diag)
+    -> std::vector<Token>
+{
+    Scanner scanner(file, diag);
+    std::vector<Token> toks;
+    for (Token tok = scanner.next_token(); tok.is_not(TokenKind::eof);
+         tok = scanner.next_token())
+        toks.push_back(tok);
+    return toks;
+}
+
+// Tokens are the most numerous values holding locations, so their size shows
+// up as memory traffic when lexing into an array.
+void BM_source_loc_lex_tokens(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file =
+        source_map.create_owned_filemap("stmts.c", make_statements(20'000));
+    size_t num_tokens = 0;
+
+    for (auto _ : state)
+    {
+        const auto toks = lex_all(file, diag);
+        num_tokens = toks.size();
+        benchmark::DoNotOptimize(toks.data());
+    }
+
+    report_sizes(state);
+    state.counters["token_bytes"] =
+        static_cast<double>(num_tokens * sizeof(Token));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_tokens));
+}
+BENCHMARK(BM_source_loc_lex_tokens);
+
+// Walks an array of tokens that doesn't fit in cache, as a parser would.
+void BM_source_loc_scan_tokens(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file =
+        source_map.create_owned_filemap("stmts.c", make_statements(200'000));
+    const auto toks = lex_all(file, diag);
+
+    for (auto _ : state)
+    {
+        size_t num_identifiers = 0;
+        for (const Token &tok : toks)
+            num_identifiers += tok.is(TokenKind::identifier) ? tok.size() : 0;
+        benchmark::DoNotOptimize(num_identifiers);
+    }
+
+    report_sizes(state);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(toks.size() * sizeof(Token)));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(toks.size()));
+}
+BENCHMARK(BM_source_loc_scan_tokens);
+
+// Resolves token locations into lines and columns, which goes through the
+// file map and line tables, both of which hold locations.
+void BM_source_loc_lookup(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    for (size_t i = 0; i < 1'000; ++i)
+    {
+        source_map.create_owned_filemap("header" + std::to_string(i) + ".h",
+                                        make_statements(20));
+    }
+    const auto &file =
+        source_map.create_owned_filemap("stmts.c", make_statements(20'000));
+    auto toks = lex_all(file, diag);
+    std::reverse(toks.begin(), toks.end());
+
+    for (auto _ : state)
+    {
+        for (const Token &tok : toks)
+        {
+            benchmark::DoNotOptimize(
+                source_map.lookup_source_location(tok.location()));
+        }
+    }
+
+    report_sizes(state);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(toks.size()));
+}
+BENCHMARK(BM_source_loc_lookup);
+
+} // namespace
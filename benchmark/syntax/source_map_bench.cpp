@@ -0,0 +1,295 @@
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_file_cache.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/util/file_stream.hpp"
+#include "cci/util/filesystem.hpp"
+#include "benchmark/benchmark.h"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using cci::syntax::ByteLoc;
+using cci::syntax::Scanner;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+namespace {
+
+// Loads `num_files - 1` small headers, followed by the file that is scanned,
+// which is what a translation unit looks like after its includes are loaded.
+auto make_source_map_with_headers(SourceMap &source_map, size_t num_files)
+    -> const cci::syntax::FileMap &
+{
+    for (size_t i = 1; i < num_files; ++i)
+    {
+        source_map.create_owned_filemap(
+            "header" + std::to_string(i) + ".h",
+            "extern int global_" + std::to_string(i) + ";\n");
+    }
+
+    std::string source;
+    for (size_t i = 0; i < 2'000; ++i)
+        source.append("int f(int a, int b) { return a * b + 42; }\n");
+    return source_map.create_owned_filemap("main.c", std::move(source));
+}
+
+void BM_scan_with_many_filemaps(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = make_source_map_with_headers(
+        source_map, static_cast<size_t>(state.range(0)));
+    size_t num_tokens = 0;
+
+    for (auto _ : state)
+    {
+        Scanner scanner(file, diag);
+        num_tokens = 0;
+        while (scanner.next_token().is_not(TokenKind::eof))
+            ++num_tokens;
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_tokens));
+}
+BENCHMARK(BM_scan_with_many_filemaps)->RangeMultiplier(10)->Range(1, 10'000);
+
+// Looks up locations spread over all the files, so the last file cache
+// almost never hits and every lookup does the binary search.
+void BM_lookup_filemap_scattered(benchmark::State &state)
+{
+    SourceMap source_map;
+    const auto &last = make_source_map_with_headers(
+        source_map, static_cast<size_t>(state.range(0)));
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint32_t> dist(
+        0, static_cast<uint32_t>(last.end_loc));
+    std::vector<ByteLoc> locs(4'096);
+    for (ByteLoc &loc : locs)
+        loc = ByteLoc(dist(gen));
+
+    for (auto _ : state)
+    {
+        for (const ByteLoc loc : locs)
+            benchmark::DoNotOptimize(source_map.lookup_filemap_idx(loc));
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(locs.size()));
+}
+BENCHMARK(BM_lookup_filemap_scattered)->RangeMultiplier(10)->Range(1, 10'000);
+
+// Reports diagnostics all over a file whose comments are written in Chinese,
+// so resolving each column has to account for up to 100k multibyte
+// characters before it. Locations are only resolved when asked for, so the
+// emitter does it, like one printing the diagnostics would.
+void BM_report_diagnostics_multibyte(benchmark::State &state)
+{
+    SourceMap source_map;
+    size_t columns = 0;
+    cci::diag::Handler diag(
+        [&](const cci::diag::Diagnostic &d) {
+            columns += static_cast<size_t>(d.source_location().column);
+        },
+        source_map);
+
+    // Each line has 20 multibyte characters.
+    std::string source;
+    for (size_t i = 0; i < 5'000; ++i)
+        source.append("int x; // 这是一个中文注释，用来说明这个变量的用途。\n");
+    const auto &file =
+        source_map.create_owned_filemap("comments.c", std::move(source));
+    const auto &lines = file.source_file().lines();
+    const auto num_lines = lines.size() - 1;
+
+    std::vector<ByteLoc> locs;
+    for (size_t i = 0; i < 4'000; ++i)
+        locs.push_back(file.start_loc + lines[(i * 7919) % num_lines] +
+                       ByteLoc(4));
+
+    for (auto _ : state)
+    {
+        for (const ByteLoc loc : locs)
+            diag.report(loc, cci::diag::Diag::unknown_character).args('x');
+    }
+
+    benchmark::DoNotOptimize(columns);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(locs.size()));
+}
+BENCHMARK(BM_report_diagnostics_multibyte);
+
+// Builds the line and multibyte character tables of an 8 MB file, either in
+// plain ASCII or with a comment in Chinese on every other line.
+// The line table is only built on the first lookup, so the second argument
+// tells whether to pay for it too or to only measure creating the file map.
+// Copying the source isn't measured but still takes time, hence the fixed
+// iteration count.
+void BM_create_filemap(benchmark::State &state)
+{
+    const bool multibyte = state.range(0) != 0;
+    const bool build_index = state.range(1) != 0;
+    std::string source;
+    while (source.size() < 8'000'000)
+    {
+        source.append("    total += compute(values[i], weights[i]);\n");
+        source.append(multibyte ? "    // 累加加权后的结果。\n"
+                                : "    // Accumulates the weighted result.\n");
+    }
+
+    // Keeps the source maps alive until setting up the next iteration, so
+    // that freeing them isn't measured.
+    std::optional<SourceMap> source_map;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        source_map.emplace();
+        std::string copy = source;
+        state.ResumeTiming();
+
+        const auto &file =
+            source_map->create_owned_filemap("big.c", std::move(copy));
+        if (build_index)
+            benchmark::DoNotOptimize(file.source_file().lines().data());
+        benchmark::DoNotOptimize(&file);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_create_filemap)
+    ->ArgsProduct({{0, 1}, {0, 1}})
+    ->Iterations(100)
+    ->Unit(benchmark::kMillisecond);
+
+// Loads an 8 MB file and builds its line table, which touches every byte of
+// it, either mapping it (argument 1) or reading it into a string (argument
+// 0). The file stays in the page cache, so this measures the cost of copying
+// the source rather than the I/O.
+void BM_load_filemap(benchmark::State &state)
+{
+    const bool mapped = state.range(0) != 0;
+    std::string source;
+    while (source.size() < 8'000'000)
+        source.append("    total += compute(values[i], weights[i]);\n");
+
+    const auto path = fs::temp_directory_path() / "cci_load_filemap_bench.c";
+    cci::write_stream(path, reinterpret_cast<const std::byte *>(source.data()),
+                      source.size());
+
+    for (auto _ : state)
+    {
+        SourceMap source_map;
+        const auto *file =
+            mapped ? source_map.load_filemap(path)
+                   : &source_map.create_owned_filemap(
+                         path.string(), *cci::read_stream_utf8(path));
+        benchmark::DoNotOptimize(file->source_file().lines().data());
+    }
+
+    fs::remove(path);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_load_filemap)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Loads 1000 headers of 20 KB each and builds their line tables: one by one
+// (argument 0), batched through io_uring (1), or batched with a thread pool
+// (2). The files are in the page cache, so this only shows the overhead of
+// each way of reading them; with cold caches, batching also overlaps the
+// latency of every read.
+void BM_load_filemaps(benchmark::State &state)
+{
+    const auto dir = fs::temp_directory_path() / "cci_load_filemaps_bench";
+    fs::create_directories(dir);
+
+    std::string source;
+    while (source.size() < 20'000)
+        source.append("extern int compute(const struct context *ctx);\n");
+
+    std::vector<fs::path> paths;
+    for (size_t i = 0; i < 1'000; ++i)
+    {
+        paths.push_back(dir / ("header" + std::to_string(i) + ".h"));
+        cci::write_stream(paths.back(),
+                          reinterpret_cast<const std::byte *>(source.data()),
+                          source.size());
+    }
+
+    for (auto _ : state)
+    {
+        SourceMap source_map;
+        switch (state.range(0))
+        {
+            case 0:
+                for (const auto &path : paths)
+                    source_map
+                        .create_owned_filemap(path.string(),
+                                              *cci::read_stream_utf8(path))
+                        .source_file()
+                        .lines();
+                break;
+            case 1:
+                source_map.load_filemaps(paths);
+                break;
+            case 2:
+                source_map.load_filemaps(paths,
+                                         cci::BatchReadBackend::thread_pool);
+                break;
+        }
+        benchmark::DoNotOptimize(source_map.next_start_loc());
+    }
+
+    fs::remove_all(dir);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(paths.size()) *
+                            static_cast<int64_t>(source.size()));
+}
+BENCHMARK(BM_load_filemaps)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+// Loads the same 200 headers of 20 KB each into a fresh source map, as done
+// for every translation unit in batch mode, and resolves a location in each
+// of them: without a cache (argument 0), or through a shared cache (1).
+void BM_load_translation_unit(benchmark::State &state)
+{
+    const auto dir = fs::temp_directory_path() / "cci_translation_unit_bench";
+    fs::create_directories(dir);
+
+    std::string source;
+    while (source.size() < 20'000)
+        source.append("extern int compute(const struct context *ctx);\n");
+
+    std::vector<fs::path> paths;
+    for (size_t i = 0; i < 200; ++i)
+    {
+        paths.push_back(dir / ("header" + std::to_string(i) + ".h"));
+        cci::write_stream(paths.back(),
+                          reinterpret_cast<const std::byte *>(source.data()),
+                          source.size());
+    }
+
+    cci::syntax::SourceFileCache cache;
+    for (auto _ : state)
+    {
+        SourceMap source_map;
+        for (const auto &path : paths)
+        {
+            const auto &file = state.range(0) == 0
+                                   ? *source_map.load_filemap(path)
+                                   : source_map.add_filemap(cache.load(path));
+            benchmark::DoNotOptimize(source_map.lookup_source_location(
+                file.end_loc - ByteLoc(1)));
+        }
+    }
+
+    fs::remove_all(dir);
+}
+BENCHMARK(BM_load_translation_unit)->Arg(0)->Arg(1)->Unit(
+    benchmark::kMillisecond);
+
+} // namespace
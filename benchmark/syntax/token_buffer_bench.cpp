@@ -0,0 +1,174 @@
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "cci/syntax/token_buffer.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using cci::syntax::Scanner;
+using cci::syntax::SourceMap;
+using cci::syntax::Token;
+using cci::syntax::TokenBuffer;
+using cci::syntax::TokenCursor;
+using cci::syntax::TokenKind;
+
+namespace {
+
+auto make_function_bodies(size_t num_functions) -> std::string
+{
+    std::string source;
+    for (size_t i = 0; i < num_functions; ++i)
+    {
+        source.append("static int function_" + std::to_string(i) +
+                      "(const struct node *n, unsigned long k)\n"
+                      "{\n"
+                      "    if (n->left != 0 && k < 42u)\n"
+                      "        return lookup(n->left[k], \"left\") + 1;\n"
+                      "    return n->value * 3 - (int)k;\n"
+                      "}\n");
+    }
+    return source;
+}
+
+// Baseline: pulls tokens one at a time and keeps them in an array of tokens.
+void BM_lex_into_token_vector(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = source_map.create_owned_filemap(
+        "bodies.c", make_function_bodies(2'000));
+    size_t num_tokens = 0;
+
+    for (auto _ : state)
+    {
+        Scanner scanner(file, diag);
+        std::vector<Token> toks;
+        for (Token tok = scanner.next_token(); tok.is_not(TokenKind::eof);
+             tok = scanner.next_token())
+            toks.push_back(tok);
+        num_tokens = toks.size();
+        benchmark::DoNotOptimize(toks.data());
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(file.src_view().size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_tokens));
+}
+BENCHMARK(BM_lex_into_token_vector);
+
+void BM_lex_into_token_buffer(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = source_map.create_owned_filemap(
+        "bodies.c", make_function_bodies(2'000));
+    size_t num_tokens = 0;
+
+    for (auto _ : state)
+    {
+        const auto tokens = TokenBuffer::lex(file, diag);
+        num_tokens = tokens.size();
+        benchmark::DoNotOptimize(&tokens);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(file.src_view().size()));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(num_tokens));
+}
+BENCHMARK(BM_lex_into_token_buffer);
+
+// Lexes an amalgamation-sized file split into `state.range(0)` chunks.
+void BM_lex_parallel(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = source_map.create_owned_filemap(
+        "amalgamation.c", make_function_bodies(40'000));
+    const auto num_chunks = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state)
+    {
+        const auto tokens = TokenBuffer::lex_parallel(file, diag, num_chunks);
+        benchmark::DoNotOptimize(&tokens);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(file.src_view().size()));
+}
+BENCHMARK(BM_lex_parallel)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// Walks a lexed buffer with a lookahead of two tokens, which is what the
+// parser does when deciding between productions.
+void BM_token_cursor_lookahead(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const auto &file = source_map.create_owned_filemap(
+        "bodies.c", make_function_bodies(2'000));
+    const auto tokens = TokenBuffer::lex(file, diag);
+
+    for (auto _ : state)
+    {
+        TokenCursor cursor(tokens);
+        size_t num_arrows = 0;
+        while (cursor.peek_kind() != TokenKind::eof)
+        {
+            num_arrows += cursor.peek_kind(1) == TokenKind::arrow;
+            cursor.consume();
+        }
+        benchmark::DoNotOptimize(num_arrows);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(tokens.size()));
+}
+BENCHMARK(BM_token_cursor_lookahead);
+
+// Types a character into the middle of a file of 50k lines and updates its
+// tokens, either by relexing around the edit (1) or the whole file (0). The
+// file map is updated in place, as an editor session would.
+void BM_relex_keystroke(benchmark::State &state)
+{
+    SourceMap source_map;
+    cci::diag::Handler diag(cci::diag::ignoring_emitter(), source_map);
+    const cci::syntax::FileMap *file = &source_map.create_owned_filemap(
+        "bodies.c", make_function_bodies(50'000 / 6));
+    auto tokens = TokenBuffer::lex(*file, diag);
+    const bool incremental = state.range(0) != 0;
+
+    // Alternates between inserting and removing a character in the name of
+    // a function, so the file neither grows nor breaks.
+    const size_t offset = file->src_view().find("function_4000(") + 9;
+    bool insert = true;
+
+    for (auto _ : state)
+    {
+        const cci::syntax::SourceEdit edit =
+            insert ? cci::syntax::SourceEdit{offset, 0, "x"}
+                   : cci::syntax::SourceEdit{offset, 1, ""};
+        file = &source_map.update_filemap(*file, edit);
+        if (incremental)
+            tokens.relex(*file, edit, diag);
+        else
+            tokens = TokenBuffer::lex(*file, diag);
+        benchmark::DoNotOptimize(&tokens);
+        insert = !insert;
+    }
+
+    state.counters["tokens"] = static_cast<double>(tokens.size());
+}
+BENCHMARK(BM_relex_keystroke)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
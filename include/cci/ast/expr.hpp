@@ -21,6 +21,7 @@ enum class ExprValueKind
 enum class ExprClass
 {
     IntegerLiteral,
+    FloatingLiteral,
     CharacterConstant,
     StringLiteral,
     ParenExpr,
@@ -87,6 +88,36 @@ public:
     }
 };
 
+// Numeric constant that is a floating literal.
+//
+// The value is kept as a long double, which represents exactly any value
+// converted to float or double as well.
+struct FloatingLiteral : Expr
+{
+private:
+    long double val;
+
+    FloatingLiteral(long double val, QualType ty, syntax::ByteSpan r)
+        : Expr(ExprClass::FloatingLiteral, ExprValueKind::RValue, ty, r)
+        , val(val)
+    {}
+
+public:
+    auto value() const -> long double { return val; }
+
+    static auto create(const ASTContext &ctx, long double value, QualType ty,
+                       syntax::ByteSpan source_span)
+        -> arena_ptr<FloatingLiteral>
+    {
+        return new (ctx) FloatingLiteral(value, ty, source_span);
+    }
+
+    static bool classof(ExprClass ec)
+    {
+        return ExprClass::FloatingLiteral == ec;
+    }
+};
+
 enum class CharacterConstantKind
 {
     Ascii,
@@ -303,6 +334,7 @@ public:
 
 static_assert(std::is_trivially_destructible_v<Expr>);
 static_assert(std::is_trivially_destructible_v<IntegerLiteral>);
+static_assert(std::is_trivially_destructible_v<FloatingLiteral>);
 static_assert(std::is_trivially_destructible_v<CharacterConstant>);
 static_assert(std::is_trivially_destructible_v<StringLiteral>);
 static_assert(std::is_trivially_destructible_v<ParenExpr>);
@@ -56,4 +56,11 @@ constexpr inline bool is_ascii(char c)
     return static_cast<unsigned char>(c) <= 127;
 }
 
+constexpr inline bool is_newline(char c) { return c == '\n' || c == '\r'; }
+
+constexpr inline bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || is_newline(c) || c == '\v' || c == '\f';
+}
+
 } // namespace cci
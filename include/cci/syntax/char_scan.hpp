@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cci::syntax {
+
+/// Number of bytes classified per iteration by the vectorized searches. This
+/// is 32 when compiled with AVX2, 16 with SSE2, and 1 otherwise.
+extern const size_t char_scan_block_size;
+
+/// Skips whitespace characters, i.e. ' ', '\t', '\n', '\v', '\f' and '\r'.
+//
+/// Whole blocks of `char_scan_block_size` bytes are classified at a time, and
+/// the remaining tail of the range is handled one character at a time.
+///
+/// Escaped newlines and trigraphs start with either '\' or '?', which are not
+/// whitespace, so this stops right at them and lets the scanner decode them.
+///
+/// \param ptr Pointer to the first character to be skipped.
+/// \param end Pointer past the last character that may be skipped.
+///
+/// \return A pointer to the first non-whitespace character in the range, or
+///         `end` if there is none.
+auto skip_whitespace(const char *ptr, const char *end) -> const char *;
+
+/// Same as `skip_whitespace`, except that it only looks at one character at
+/// a time. This is the baseline the vectorized version is measured against.
+auto skip_whitespace_scalar(const char *ptr, const char *end) -> const char *;
+
+/// Finds the next character that is relevant to the scanning of a line
+/// comment, i.e. '\n', '\r', '\0', or the start of a possible escaped newline
+/// ('\' or '?', for the "??/" trigraph).
+//
+/// Any character before the one returned can be skipped over without decoding.
+///
+/// \return A pointer to the first relevant character, or `end` if there is
+///         none.
+auto find_line_comment_stop(const char *ptr, const char *end) -> const char *;
+
+/// Same as `find_line_comment_stop`, except that it only looks at one
+/// character at a time.
+auto find_line_comment_stop_scalar(const char *ptr, const char *end)
+    -> const char *;
+
+/// Finds the next character that is relevant to the scanning of a block
+/// comment, i.e. '/', '\0', or the start of a possible escaped newline ('\' or
+/// '?', for the "??/" trigraph).
+//
+/// Whether a '/' ends the comment depends on the character before it, which is
+/// always a trivial character when it is part of the skipped range.
+///
+/// \return A pointer to the first relevant character, or `end` if there is
+///         none.
+auto find_block_comment_stop(const char *ptr, const char *end) -> const char *;
+
+/// Same as `find_block_comment_stop`, except that it only looks at one
+/// character at a time.
+auto find_block_comment_stop_scalar(const char *ptr, const char *end)
+    -> const char *;
+
+/// Number of newlines and non-ASCII bytes in a range of characters.
+struct ByteCounts
+{
+    size_t newlines = 0;
+    size_t non_ascii = 0;
+};
+
+/// Counts the '\n' characters and the bytes with their high bit set, i.e. the
+/// bytes that are part of multibyte UTF-8 characters.
+//
+/// This is meant to size the line and multibyte character tables of a source
+/// before building them, and to tell whether the source is plain ASCII.
+auto count_newlines_and_non_ascii(const char *ptr, const char *end)
+    -> ByteCounts;
+
+/// Same as `count_newlines_and_non_ascii`, except that it only looks at one
+/// character at a time.
+auto count_newlines_and_non_ascii_scalar(const char *ptr, const char *end)
+    -> ByteCounts;
+
+/// Number of bytes classified at a time by `classify_line_chunk`.
+constexpr size_t line_chunk_size = 64;
+
+/// Bit masks of the bytes in a chunk of `line_chunk_size` bytes that matter to
+/// build a line table, where bit N corresponds to the Nth byte of the chunk.
+struct LineChunkMasks
+{
+    uint64_t newlines = 0; ///< '\n' characters.
+    uint64_t non_ascii = 0; ///< Bytes with their high bit set.
+};
+
+/// Classifies the `line_chunk_size` bytes starting at `ptr`, all of which must
+/// be readable.
+//
+/// Callers walk the set bits of the masks instead of looking at every byte,
+/// which is how the line and multibyte character tables of a `FileMap` are
+/// built.
+auto classify_line_chunk(const char *ptr) -> LineChunkMasks;
+
+} // namespace cci::syntax
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "cci/syntax/diagnostics.hpp"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace cci::diag {
+
+/// A diagnostic handler shared by many threads, e.g. ones compiling many
+/// translation units at once.
+//
+/// Each reporting thread gets an emitter of its own from `make_emitter`, and
+/// reports through a `Handler` of its own as usual. That emitter copies the
+/// diagnostics into a queue of its own without taking any lock, and a single
+/// consumer thread drains all of the queues and hands the diagnostics over to
+/// the real emitter.
+///
+/// Diagnostics are handed over ordered by translation unit, then by location,
+/// so the output is the same however the threads are scheduled. That's why
+/// the consumer only emits the diagnostics of translation units it's told are
+/// finished, see `emit_finished`.
+struct ConcurrentHandler
+{
+    /// Constructs a handler which eventually passes all diagnostics reported
+    /// through its emitters to `emitter`, from the consumer thread.
+    explicit ConcurrentHandler(Handler::Emitter emitter)
+        : emitter(std::move(emitter))
+    {}
+
+    ConcurrentHandler(const ConcurrentHandler &) = delete;
+    ConcurrentHandler &operator=(const ConcurrentHandler &) = delete;
+
+    ~ConcurrentHandler();
+
+    /// Returns an emitter which queues diagnostics of the translation unit
+    /// numbered `tu`.
+    //
+    /// This can be called from any thread. Each emitter has a queue of its
+    /// own with a single producer, so it, and any copy of it, must only be
+    /// called from one thread at a time. The queue is closed once the last
+    /// copy is destroyed, which must happen before this handler is, and is
+    /// freed by the next `collect` after that. The source maps of the queued
+    /// diagnostics must outlive their emission.
+    auto make_emitter(size_t tu) -> Handler::Emitter;
+
+    /// Moves the diagnostics queued so far out of the queues, without waiting
+    /// on the threads reporting them, and frees the queues that were closed.
+    /// Only the consumer thread may call this.
+    void collect();
+
+    /// Emits the diagnostics of the translation units numbered below
+    /// `tu_end`, ordered by translation unit, then by location. Only the
+    /// consumer thread may call this.
+    //
+    /// Those translation units must be done reporting, e.g. by having joined
+    /// the threads that compiled them, as their diagnostics would otherwise be
+    /// emitted out of order, or not at all.
+    void emit_finished(size_t tu_end);
+
+    /// Emits all diagnostics, once every translation unit is done reporting.
+    void emit_all();
+
+    /// Returns how many diagnostics have been emitted so far.
+    auto emitted_count() const -> size_t { return this->num_emitted; }
+
+    /// Returns how many queues haven't been freed yet. Only the consumer
+    /// thread may call this.
+    auto queue_count() const -> size_t;
+
+private:
+    struct Queue;
+
+    /// A diagnostic taken out of a queue, waiting to be emitted.
+    struct Pending
+    {
+        size_t tu;
+        Diagnostic diag;
+    };
+
+    Handler::Emitter emitter;
+
+    /// All queues not freed yet, most recent first. Producers only ever
+    /// link new queues in front, so the rest of the list is only changed by
+    /// the consumer.
+    std::atomic<Queue *> queues = nullptr;
+
+    /// Unlinks `queue` from the list, given the queue before it, if any.
+    /// Returns the queue before it after all, as new queues may have been
+    /// linked in front of it.
+    auto unlink(Queue *queue, Queue *prev) -> Queue *;
+
+    /// Collected diagnostics, in no particular order.
+    std::vector<Pending> pending;
+
+    size_t num_emitted = 0;
+};
+
+} // namespace cci::diag
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "cci/syntax/diagnostics_new.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/util/filesystem.hpp"
+#include "cci/util/span.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cci::diag2 {
+
+/// Appends `diag` rendered as text to `out`, as a "file:line:column: message"
+/// line, or a "message" line if it has no caret.
+//
+/// Each `{name}` in the message is replaced by the argument of the parameter
+/// `name`. Placeholders without such an argument are left as they are.
+void render_text(const Diagnostic &diag, const syntax::SourceMap &source_map,
+                 std::string &out);
+
+/// Serializes diagnostics into a compact binary stream.
+//
+/// A stream starts with a header, followed by records in the order they're
+/// written. File names are written once, as a file record preceding the
+/// first diagnostic that refers to the file, so any prefix of a stream that
+/// ends with a record can be read. Each diagnostic record holds:
+///
+/// - the index of its descriptor in the catalog shared with the reader;
+/// - its caret, as a file index, byte offset, line and column;
+/// - its spans, as a file index, byte offset and size each;
+/// - its arguments, each with its parameter index and kind.
+///
+/// Integers are LEB128 varints, and records are prefixed with their size so
+/// that readers can skip them. The stream only grows by reallocating its
+/// buffer, so writing doesn't allocate for each diagnostic. Once written, the
+/// bytes can be saved as they are with `write_stream`.
+class DiagnosticWriter
+{
+public:
+    /// Constructs a writer of diagnostics located in `source_map`, whose
+    /// descriptors are all in `catalog`.
+    DiagnosticWriter(const syntax::SourceMap &source_map,
+                     span<const DiagnosticDescriptor *const> catalog);
+
+    /// Appends a diagnostic to the stream.
+    void write(const Diagnostic &diag);
+
+    /// Appends all diagnostics of `bag` to the stream.
+    //
+    /// This resolves the lines and columns of all carets at once, see
+    /// `SourceMap::lookup_source_locations`.
+    void write(const DiagnosticBag &bag);
+
+    /// Returns the stream written so far.
+    auto data() const -> span<const std::byte> { return this->stream; }
+
+    /// Writes the stream written so far to the file at `path`.
+    auto save(const fs::path &path) const -> bool;
+
+private:
+    const syntax::SourceMap &source_map;
+    std::unordered_map<const DiagnosticDescriptor *, uint32_t> descriptor_ids;
+    std::unordered_map<const syntax::FileMap *, uint32_t> file_ids;
+    std::vector<std::byte> stream;
+    std::vector<std::byte> record;
+
+    void write(const Diagnostic &diag,
+               const std::optional<syntax::SourceLoc> &caret);
+    auto file_id(const syntax::FileMap &file) -> uint32_t;
+};
+
+/// A diagnostic read from a binary stream.
+//
+/// This refers to the bytes of the stream and to the file table of its
+/// reader, so it's only valid as long as both are. The spans and arguments of
+/// the diagnostic are only decoded when they're asked for.
+class DiagnosticRecord
+{
+public:
+    /// A location in a file of the stream.
+    struct Location
+    {
+        std::string_view file_name;
+        uint32_t offset = 0;
+    };
+
+    /// The caret location of a diagnostic.
+    struct Caret : Location
+    {
+        uint32_t line = 0;
+        uint32_t column = 0;
+    };
+
+    /// A span of a diagnostic.
+    struct Span : Location
+    {
+        uint32_t size = 0;
+    };
+
+    const DiagnosticDescriptor *descriptor = nullptr;
+    std::optional<Caret> caret;
+
+    /// Returns the number of spans.
+    auto span_count() const -> size_t { return this->num_spans; }
+
+    /// Decodes the span at `index`.
+    auto span_at(size_t index) const -> Span;
+
+    /// Decodes the argument of the parameter at `index`, if it was given one.
+    //
+    /// String arguments refer to the bytes of the stream.
+    auto arg(size_t index) const -> std::optional<DiagnosticArg>;
+
+    /// Appends the diagnostic rendered as text to `out`, the same way
+    /// `render_text` does.
+    void render(std::string &out) const;
+
+private:
+    friend class DiagnosticReader;
+
+    const std::vector<std::string_view> *files = nullptr;
+    span<const std::byte> spans_data;
+    span<const std::byte> args_data;
+    size_t num_spans = 0;
+};
+
+/// Reads diagnostics from a binary stream written by a `DiagnosticWriter`.
+class DiagnosticReader
+{
+public:
+    /// Constructs a reader of `stream`, whose descriptors are indexes into
+    /// `catalog`. Neither is copied, so both must outlive the reader and the
+    /// records it reads.
+    DiagnosticReader(span<const std::byte> stream,
+                     span<const DiagnosticDescriptor *const> catalog);
+
+    /// Reads the next diagnostic, or returns nothing at the end of the stream
+    /// or if it's malformed.
+    auto next() -> std::optional<DiagnosticRecord>;
+
+    /// Returns whether reading stopped on malformed data.
+    auto is_malformed() const -> bool { return this->malformed; }
+
+private:
+    span<const std::byte> stream;
+    span<const DiagnosticDescriptor *const> catalog;
+    std::vector<std::string_view> files;
+    size_t pos = 0;
+    bool malformed = false;
+};
+
+} // namespace cci::diag2
@@ -3,11 +3,14 @@
 #include "cci/syntax/source_map.hpp"
 #include "cci/syntax/token.hpp"
 #include "cci/util/contracts.hpp"
+#include "cci/util/memory_resource.hpp"
+#include "cci/util/scope_guard.hpp"
 #include "cci/util/small_vector.hpp"
 #include <atomic>
 #include <functional>
 #include <optional>
 #include <string>
+#include <utility>
 #include <variant>
 
 namespace cci::diag {
@@ -19,6 +22,7 @@ enum class Diag
     expected_but_got,
     integer_literal_overflow,
     integer_literal_too_large,
+    float_literal_overflow,
     invalid_digit,
     invalid_suffix,
     missing_exponent_digits,
@@ -47,37 +51,74 @@ struct Diagnostic
 {
     using Arg = std::variant<syntax::TokenKind, char>;
 
-    /// Location from where the diagnostic was reported.
-    syntax::SourceLoc loc;
+    /// Source map in which `loc` and `ranges` are.
+    const syntax::SourceMap *source_map;
+
+    /// Location from where the diagnostic was reported. This is only resolved
+    /// into a line and column by `source_location`, as emitters that filter
+    /// out or count diagnostics never need them.
+    syntax::ByteLoc loc;
 
     /// The diagnostic message.
     Diag msg;
 
-    /// Location ranges that are related to this diagnostic.
-    std::vector<syntax::ByteSpan> ranges;
+    /// Location ranges that are related to this diagnostic. Most diagnostics
+    /// have at most a couple of them, so these are stored inline.
+    small_vector<syntax::ByteSpan, 2> ranges;
 
     /// Arguments for the format message.
-    std::vector<Arg> args;
+    small_vector<Arg, 4> args;
+
+    Diagnostic(const syntax::SourceMap &source_map, syntax::ByteLoc loc,
+               Diag msg)
+        : source_map(&source_map), loc(loc), msg(msg)
+    {}
+
+    /// Resolves `loc` into a file, line and column.
+    //
+    /// This takes logarithmic time in the size of the file. Emitters resolving
+    /// many diagnostics at once should rather gather their locations for
+    /// `SourceMap::lookup_source_locations`.
+    auto source_location() const -> syntax::SourceLoc
+    {
+        return this->source_map->lookup_source_location(this->loc);
+    }
+};
+
+/// Storage for a diagnostic owned by a `Handler`, either being built, or free
+/// to be reused by the next report.
+struct DiagnosticSlot
+{
+    Diagnostic diag;
 
-    Diagnostic(syntax::SourceLoc loc, Diag msg) : loc(loc), msg(msg) {}
+    /// Next free slot of the handler, if this slot is free.
+    DiagnosticSlot *next_free = nullptr;
 };
 
 /// Helper class to construct a `Diagnostic`.
+//
+/// The diagnostic is built in place in a slot borrowed from the handler, and
+/// emitted when the builder is destroyed, which then gives the slot back.
 struct DiagnosticBuilder
 {
-    DiagnosticBuilder(syntax::SourceLoc loc, Diag msg, Handler &handler)
-        : handler(&handler), diag(std::make_unique<Diagnostic>(loc, msg))
+    DiagnosticBuilder(DiagnosticSlot &slot, Handler &handler)
+        : handler(&handler), slot(&slot)
+    {}
+
+    DiagnosticBuilder(DiagnosticBuilder &&other) noexcept
+        : handler(other.handler), slot(std::exchange(other.slot, nullptr))
     {}
 
-    DiagnosticBuilder(DiagnosticBuilder &&) = default;
-    DiagnosticBuilder &operator=(DiagnosticBuilder &&) = default;
+    DiagnosticBuilder(const DiagnosticBuilder &) = delete;
+    DiagnosticBuilder &operator=(const DiagnosticBuilder &) = delete;
+    DiagnosticBuilder &operator=(DiagnosticBuilder &&) = delete;
 
     /// Adds a source range to give more context to the diagnostic.
     auto ranges(std::initializer_list<syntax::ByteSpan> ranges)
         -> DiagnosticBuilder &
     {
-        for (const syntax::ByteSpan r : ranges)
-            this->diag->ranges.push_back(r);
+        cci_expects(this->slot);
+        this->slot->diag.ranges.append(ranges.begin(), ranges.end());
         return *this;
     }
 
@@ -85,19 +126,21 @@ struct DiagnosticBuilder
     template <typename... Args>
     auto args(Args &&... args) -> DiagnosticBuilder &
     {
-        ((void)this->diag->args.push_back(std::forward<Args>(args)), ...);
+        cci_expects(this->slot);
+        ((void)this->slot->diag.args.push_back(std::forward<Args>(args)), ...);
         return *this;
     }
 
-    /// Hands the diagnostic to the handler.
+    /// Hands the diagnostic to the handler, unless it has been moved out.
     ~DiagnosticBuilder() noexcept(!CCI_CONTRACTS);
 
 private:
     /// The handler to which the diagnostic will be handed.
     Handler *handler;
 
-    /// Diagnostic which is being constructed.
-    std::unique_ptr<Diagnostic> diag;
+    /// Slot in which the diagnostic is being constructed, or null if this
+    /// builder was moved from.
+    DiagnosticSlot *slot;
 };
 
 /// A diagnostic handler.
@@ -106,6 +149,12 @@ private:
 /// diagnostic is passed to an emitter (a function callback) responsible to
 /// treat it. It may do anything like aborting compilation process, or just
 /// completely ignore diagnostics.
+///
+/// Diagnostics are built in slots allocated from an arena owned by the
+/// handler, and a slot is reused once its diagnostic has been emitted, so
+/// reporting doesn't allocate once a few diagnostics have been reported. The
+/// emitter must therefore copy whatever it wants to keep from a diagnostic.
+/// Reporting isn't thread-safe, each thread should use its own handler.
 struct Handler
 {
     const syntax::SourceMap &source_map;
@@ -122,12 +171,12 @@ struct Handler
     Handler(Handler &&other) = delete;
     Handler &operator=(Handler &&other) = delete;
 
+    ~Handler();
+
     /// Helper function to facilitate the construction of a `DiagnosticBuilder`.
     auto report(syntax::ByteLoc loc, Diag msg) -> DiagnosticBuilder
     {
-        DiagnosticBuilder builder(source_map.lookup_source_location(loc), msg,
-                                  *this);
-        return builder;
+        return DiagnosticBuilder(this->acquire(loc, msg), *this);
     }
 
     /// Checks whether there has been any errors reported.
@@ -144,19 +193,34 @@ protected:
     Emitter emitter;
     friend struct DiagnosticBuilder;
 
-    /// Emits a diagnostic.
-    void emit(std::unique_ptr<Diagnostic> diag)
+    /// Emits the diagnostic in `slot`, and makes the slot free again, even if
+    /// the emitter throws.
+    void emit(DiagnosticSlot &slot)
     {
-        cci_expects(diag);
-        this->emitter(*diag);
+        ScopeGuard release_slot([&] { this->release(slot); });
+        this->emitter(slot.diag);
         this->bump_err_count();
     }
 
 private:
     std::atomic<size_t> err_count_ = 0;
 
+    /// Arena from which diagnostic slots are allocated.
+    pmr::monotonic_buffer_resource arena;
+
+    /// Slots whose diagnostics have been emitted. Every slot is in there
+    /// when no builder is alive.
+    DiagnosticSlot *free_slots = nullptr;
+
     /// Increases the error count by one.
     void bump_err_count() { this->err_count_.fetch_add(1); }
+
+    /// Returns a slot holding an empty diagnostic, reusing a free slot if
+    /// there's any.
+    auto acquire(syntax::ByteLoc loc, Diag msg) -> DiagnosticSlot &;
+
+    /// Makes `slot` free to be acquired again.
+    void release(DiagnosticSlot &slot);
 };
 
 /// Returns a diagnostic emitter that just ignores diagnostics.
@@ -3,12 +3,15 @@
 #include "cci/syntax/source_map.hpp"
 #include "cci/syntax/token.hpp"
 #include "cci/util/contracts.hpp"
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <compare>
 #include <functional>
 #include <initializer_list>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 
 namespace cci::diag2 {
@@ -23,28 +26,98 @@ enum class DiagnosticParamKind
 struct DiagnosticParam
 {
     std::string_view name;
-    DiagnosticParamKind kind;
+    DiagnosticParamKind kind = DiagnosticParamKind::Str;
 
-    DiagnosticParam(std::string_view name, DiagnosticParamKind kind)
+    constexpr DiagnosticParam() = default;
+
+    constexpr DiagnosticParam(std::string_view name, DiagnosticParamKind kind)
         : name(name), kind(kind)
     {}
 };
 
+/// Maximum number of parameters of a diagnostic.
+inline constexpr size_t max_diagnostic_params = 4;
+
+/// The parameters of a diagnostic, stored inline so that descriptors can be
+/// constants.
+class DiagnosticParamList
+{
+    std::array<DiagnosticParam, max_diagnostic_params> params{};
+    size_t num_params = 0;
+
+public:
+    constexpr DiagnosticParamList() = default;
+
+    constexpr DiagnosticParamList(std::initializer_list<DiagnosticParam> params)
+        : num_params(params.size())
+    {
+        cci_expects(params.size() <= max_diagnostic_params);
+        std::copy(params.begin(), params.end(), this->params.begin());
+    }
+
+    constexpr auto size() const -> size_t { return this->num_params; }
+    constexpr auto begin() const { return this->params.begin(); }
+    constexpr auto end() const { return this->begin() + this->num_params; }
+
+    constexpr auto operator[](size_t index) const -> const DiagnosticParam &
+    {
+        cci_expects(index < this->num_params);
+        return this->params[index];
+    }
+
+    /// Returns the index of the parameter named `name`, if there's any.
+    constexpr auto index_of(std::string_view name) const
+        -> std::optional<size_t>
+    {
+        for (size_t i = 0; i < this->num_params; ++i)
+        {
+            if (this->params[i].name == name)
+                return i;
+        }
+        return std::nullopt;
+    }
+};
+
+/// Describes a kind of diagnostic: its message, and the parameters filled in
+/// by the arguments of each diagnostic.
+//
+/// Descriptors are meant to be `constexpr` constants, such that a
+/// `DiagnosticBuilder` can resolve parameter names at compile time.
 struct DiagnosticDescriptor
 {
     std::string_view message;
-    std::vector<DiagnosticParam> params;
+    DiagnosticParamList params;
 
-    auto get_param_by_name(std::string_view name) const
+    constexpr auto get_param_by_name(std::string_view name) const
         -> std::optional<DiagnosticParam>
     {
-        auto param_it =
-            std::find_if(this->params.begin(), this->params.end(),
-                         [name](auto param) { return param.name == name; });
-        if (param_it != this->params.end())
-            return *param_it;
-        else
-            return std::nullopt;
+        if (const auto index = this->params.index_of(name))
+            return this->params[*index];
+        return std::nullopt;
+    }
+};
+
+/// A parameter of `Descriptor` whose kind is `Kind`, resolved from its name
+/// to its index at compile time.
+//
+/// Naming a parameter that `Descriptor` doesn't have, or one of another
+/// kind, fails to compile.
+template <const DiagnosticDescriptor &Descriptor, DiagnosticParamKind Kind>
+struct DiagnosticParamRef
+{
+    size_t index;
+
+    consteval DiagnosticParamRef(const char *name) : index(resolve(name)) {}
+
+private:
+    static consteval auto resolve(std::string_view name) -> size_t
+    {
+        const auto index = Descriptor.params.index_of(name);
+        if (!index)
+            throw "the diagnostic has no parameter with this name";
+        if (Descriptor.params[*index].kind != Kind)
+            throw "the argument doesn't match the kind of the parameter";
+        return *index;
     }
 };
 
@@ -57,12 +130,13 @@ struct Arg
     auto operator<=>(const Arg &) const = default;
 };
 
+/// A string argument. This only refers to the string, which must outlive the
+/// diagnostic, e.g. a spelling in the source code or an interned string.
 struct StrArg final : Arg
 {
-    std::string value;
+    std::string_view value;
 
-    StrArg(std::string &&value)
-        : Arg(DiagnosticParamKind::Str), value(std::move(value))
+    StrArg(std::string_view value) : Arg(DiagnosticParamKind::Str), value(value)
     {}
 
     bool operator==(const StrArg &) const = default;
@@ -106,7 +180,7 @@ struct DiagnosticArg final
     template <typename T>
     auto get_as() const -> const T *
     {
-        return std::get_if<T>(arg);
+        return std::get_if<T>(&arg);
     }
 };
 
@@ -121,8 +195,9 @@ struct Diagnostic
     /// Location spans that are related to this diagnostic.
     std::vector<syntax::ByteSpan> spans;
 
-    /// Arguments for the format message.
-    std::vector<std::pair<std::string_view, DiagnosticArg>> args;
+    /// Arguments for the format message, at the index of their parameter in
+    /// the descriptor.
+    std::array<std::optional<DiagnosticArg>, max_diagnostic_params> args;
 
     Diagnostic(const DiagnosticDescriptor *descriptor,
                std::optional<syntax::ByteLoc> caret_loc)
@@ -130,6 +205,14 @@ struct Diagnostic
     {}
 
     bool operator==(const Diagnostic &) const = default;
+
+    /// Returns the argument of the parameter named `param_name`, or null if
+    /// there's no such parameter or it wasn't given an argument.
+    auto get_arg(std::string_view param_name) const -> const DiagnosticArg *
+    {
+        const auto index = this->descriptor->params.index_of(param_name);
+        return index && this->args[*index] ? &*this->args[*index] : nullptr;
+    }
 };
 
 class DiagnosticBag
@@ -148,81 +231,81 @@ public:
         this->diagnostics.push_back(std::move(diagnostic));
     }
 
+    auto size() const -> size_t { return this->diagnostics.size(); }
+
     auto begin() const -> iterator { return std::begin(diagnostics); }
+    auto end() const -> iterator { return std::end(diagnostics); }
 };
 
-/// Helper class to construct a `Diagnostic`.
+/// Helper class to construct a `Diagnostic` of `Descriptor`.
+//
+/// Arguments are given by parameter name, which is resolved at compile time,
+/// so setting one is a store into the slot of its parameter.
+template <const DiagnosticDescriptor &Descriptor>
 class DiagnosticBuilder
 {
-    const DiagnosticDescriptor *descriptor;
-    std::optional<syntax::ByteLoc> caret_loc;
-    std::vector<syntax::ByteSpan> spans;
-    std::vector<std::pair<std::string_view, DiagnosticArg>> args;
+    template <DiagnosticParamKind Kind>
+    using ParamRef = DiagnosticParamRef<Descriptor, Kind>;
+
+    Diagnostic diag{&Descriptor, std::nullopt};
 
 public:
-    DiagnosticBuilder(const DiagnosticDescriptor &descriptor)
-        : descriptor(&descriptor)
-    {}
+    DiagnosticBuilder() = default;
 
     DiagnosticBuilder(DiagnosticBuilder &&) = default;
     DiagnosticBuilder &operator=(DiagnosticBuilder &&) = default;
 
-    auto build() -> Diagnostic
-    {
-        auto diag = Diagnostic(this->descriptor, this->caret_loc);
-        diag.spans = std::move(spans);
-        diag.args = std::move(args);
-        return diag;
-    }
+    auto build() -> Diagnostic { return std::move(this->diag); }
 
     auto caret_at(syntax::ByteLoc caret_loc) -> DiagnosticBuilder &
     {
-        cci_expects(!this->caret_loc.has_value());
-        this->caret_loc = caret_loc;
+        cci_expects(!this->diag.caret_location.has_value());
+        this->diag.caret_location = caret_loc;
         return *this;
     }
 
     auto with_span(syntax::ByteSpan span) -> DiagnosticBuilder &
     {
-        this->spans.push_back(span);
+        this->diag.spans.push_back(span);
         return *this;
     }
 
-    template <typename Arg>
-    auto with_arg(std::string_view param_name, Arg &&arg) -> DiagnosticBuilder &
+    auto with_arg(ParamRef<DiagnosticParamKind::Int> param, int value)
+        -> DiagnosticBuilder &
     {
-        cci_expects(check_param_is_not_set(param_name));
-
-        auto diag_arg = DiagnosticArg(make_arg(std::forward<Arg>(arg)));
-
-        cci_expects(check_arg_kind_matches_param_kind(param_name, diag_arg));
+        return this->set_arg(param.index, IntArg(value));
+    }
 
-        this->args.emplace_back(param_name, std::move(diag_arg));
-        return *this;
+    /// The diagnostic refers to `value`, which must outlive it.
+    auto with_arg(ParamRef<DiagnosticParamKind::Str> param,
+                  std::string_view value) -> DiagnosticBuilder &
+    {
+        return this->set_arg(param.index, StrArg(value));
     }
 
-private:
-    auto make_arg(int value) -> IntArg { return value; }
-    auto make_arg(std::string value) -> StrArg { return value; }
-    auto make_arg(syntax::TokenKind token_kind) -> TokenKindArg
+    auto with_arg(ParamRef<DiagnosticParamKind::Str> param, const char *value)
+        -> DiagnosticBuilder &
     {
-        return token_kind;
+        return this->with_arg(param, std::string_view(value));
     }
 
-    auto check_arg_kind_matches_param_kind(std::string_view param_name,
-                                           DiagnosticArg &arg) const -> bool
+    // A temporary string would be gone by the time the diagnostic is used.
+    auto with_arg(ParamRef<DiagnosticParamKind::Str>, std::string &&)
+        -> DiagnosticBuilder & = delete;
+
+    auto with_arg(ParamRef<DiagnosticParamKind::TokenKind> param,
+                  syntax::TokenKind value) -> DiagnosticBuilder &
     {
-        auto param = this->descriptor->get_param_by_name(param_name);
-        cci_expects(param.has_value());
-        return arg.param_kind() == param->kind;
+        return this->set_arg(param.index, TokenKindArg(value));
     }
 
-    auto check_param_is_not_set(std::string_view param_name) const -> bool
+private:
+    auto set_arg(size_t index, DiagnosticArg::ArgType arg)
+        -> DiagnosticBuilder &
     {
-        auto arg_it = std::find_if(
-            this->args.begin(), this->args.end(),
-            [param_name](auto arg) { return arg.first == param_name; });
-        return arg_it == this->args.end();
+        cci_expects(!this->diag.args[index].has_value());
+        this->diag.args[index].emplace(std::move(arg));
+        return *this;
     }
 };
 
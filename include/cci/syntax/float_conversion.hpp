@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string_view>
+#include <utility>
+
+namespace cci::syntax {
+
+/// Converts a decimal floating constant to the nearest value of type `T`,
+/// rounding halfway cases to even.
+//
+/// Constants of up to 19 significant digits are converted with a couple of
+/// integer multiplications (the Eisel-Lemire algorithm), or with a single
+/// floating-point operation when both the digits and the power of ten are
+/// exactly representable. Longer constants usually take that path too, and
+/// only fall back to `decimal_to_float_exact` when their truncated digits
+/// could round either way.
+///
+/// \param digits The significand, with an optional period, followed by an
+///               optional exponent part, e.g. "6.02214076e23", ".5" or "1e-3".
+///               This has no suffixes, and needn't be null-terminated.
+///
+/// \return The converted value, and whether it overflowed to infinity. Values
+///         too small for `T` become zero or a subnormal number, which is not
+///         an overflow.
+template <typename T>
+auto decimal_to_float(std::string_view digits) -> std::pair<T, bool>;
+
+/// Same as `decimal_to_float`, but always computes the result with exact
+/// big integer arithmetic. This is the reference the fast paths are tested
+/// against.
+template <typename T>
+auto decimal_to_float_exact(std::string_view digits) -> std::pair<T, bool>;
+
+/// Converts a hexadecimal floating constant to the nearest value of type `T`,
+/// rounding halfway cases to even.
+//
+/// \param digits The significand, after the "0x" prefix, with an optional
+///               period, followed by the binary exponent part, e.g. "1.8p3".
+///
+/// \return The converted value, and whether it overflowed to infinity.
+template <typename T>
+auto hex_to_float(std::string_view digits) -> std::pair<T, bool>;
+
+extern template auto decimal_to_float<float>(std::string_view)
+    -> std::pair<float, bool>;
+extern template auto decimal_to_float<double>(std::string_view)
+    -> std::pair<double, bool>;
+extern template auto decimal_to_float<long double>(std::string_view)
+    -> std::pair<long double, bool>;
+
+extern template auto decimal_to_float_exact<float>(std::string_view)
+    -> std::pair<float, bool>;
+extern template auto decimal_to_float_exact<double>(std::string_view)
+    -> std::pair<double, bool>;
+extern template auto decimal_to_float_exact<long double>(std::string_view)
+    -> std::pair<long double, bool>;
+
+extern template auto hex_to_float<float>(std::string_view)
+    -> std::pair<float, bool>;
+extern template auto hex_to_float<double>(std::string_view)
+    -> std::pair<double, bool>;
+extern template auto hex_to_float<long double>(std::string_view)
+    -> std::pair<long double, bool>;
+
+} // namespace cci::syntax
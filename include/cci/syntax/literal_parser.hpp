@@ -14,6 +14,9 @@ private:
     const char *digit_begin; ///< First meaningful digit.
     const char *digit_end; ///< Past the last meaningful digit.
 
+    template <typename T>
+    auto to_floating() const -> std::pair<T, bool>;
+
 public:
     bool has_error = false;
     bool has_period = false;
@@ -29,9 +32,20 @@ public:
                           ByteLoc tok_loc);
 
     // Evaluates and returns the numeric constant to an integer constant value,
-    // as well as whether the evaluation overflowed.
+    // as well as whether the evaluation overflowed. Decimal and hexadecimal
+    // digits are converted 8 at a time.
     auto to_integer() const -> std::pair<uint64_t, bool>;
 
+    // Same as `to_integer`, but converts one digit at a time. This is the
+    // reference `to_integer` is tested against.
+    auto to_integer_scalar() const -> std::pair<uint64_t, bool>;
+
+    // Evaluates and returns the numeric constant to the nearest value of a
+    // floating type, as well as whether the evaluation overflowed to infinity.
+    auto to_float() const -> std::pair<float, bool>;
+    auto to_double() const -> std::pair<double, bool>;
+    auto to_long_double() const -> std::pair<long double, bool>;
+
     bool is_floating_literal() const { return has_period || has_exponent; }
     bool is_integer_literal() const { return !is_floating_literal(); }
 };
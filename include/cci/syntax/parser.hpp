@@ -6,6 +6,7 @@
 #include "cci/syntax/scanner.hpp"
 #include "cci/syntax/sema.hpp"
 #include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token_buffer.hpp"
 #include <optional>
 
 namespace cci::syntax {
@@ -18,10 +19,20 @@ private:
     diag::Handler &diag;
 
 public:
+    /// Constructs a parser over the tokens `scanner` has yet to return. These
+    /// are all lexed up front.
     Parser(Scanner &scanner, Sema &sema)
-        : scanner(scanner), sema(sema), diag(scanner.diag_handler)
+        : scanner(scanner)
+        , sema(sema)
+        , diag(scanner.diag_handler)
+        , tokens(TokenBuffer::lex_remaining(scanner))
+        , cursor(tokens)
     {}
 
+    // The cursor points into the token buffer.
+    Parser(const Parser &) = delete;
+    Parser &operator=(const Parser &) = delete;
+
     auto parse_expression() -> std::optional<arena_ptr<ast::Expr>>;
 
 private:
@@ -40,7 +51,8 @@ private:
         -> std::optional<arena_ptr<ast::Expr>>;
 
 private:
-    small_vector<Token, 8> peeked_toks;
+    TokenBuffer tokens;
+    TokenCursor cursor;
 };
 
 } // namespace cci::syntax
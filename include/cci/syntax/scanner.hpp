@@ -15,6 +15,8 @@ struct Scanner
 private:
     ByteLoc file_loc; ///< Start location of the file map being scanned.
 
+    const char *file_begin; ///< Iterator into the start of the file map's
+                            ///< source, which `file_loc` corresponds to.
     const char *buffer_begin; ///< Iterator into the start of the buffer.
     const char *buffer_end; ///< Iterator into the end of the buffer.
     const char *buffer_ptr; ///< Current position into the buffer to be analyzed.
@@ -38,6 +40,7 @@ public:
     Scanner(ByteLoc file_loc, const char *buf_begin, const char *buf_end,
             diag::Handler &diag)
         : file_loc(file_loc)
+        , file_begin(diag.source_map.lookup_filemap(file_loc).src_begin())
         , buffer_begin(buf_begin)
         , buffer_end(buf_end)
         , buffer_ptr(buf_begin)
@@ -47,6 +50,9 @@ public:
         // Having a null character at the end of the input makes scanning a lot
         // easier.
         cci_expects(buffer_end[0] == '\0');
+        cci_expects(buffer_begin >= file_begin && buffer_begin <= buffer_end);
+        cci_expects(buffer_end <=
+                    this->source_map.lookup_filemap(file_loc).src_end());
     }
 
     /// Constructs a scanner for a `FileMap`.
@@ -76,8 +82,28 @@ public:
     /// \return The next token in the stream.
     auto next_token() -> Token;
 
+    /// Returns the start location of the file map being scanned.
+    auto file_start_loc() const -> ByteLoc { return this->file_loc; }
+
+    /// Returns the number of bytes yet to be scanned.
+    auto remaining_size() const -> size_t
+    {
+        return static_cast<size_t>(this->buffer_end - this->buffer_ptr);
+    }
+
     /// Translates a file map's source content iterator into an absolute ByteLoc.
+    //
+    /// This is computed from the start of the file map, which is known since
+    /// construction, so the source map isn't looked up.
     auto location_for_ptr(const char *ptr) const -> ByteLoc
+    {
+        cci_expects(ptr >= this->file_begin && ptr <= this->buffer_end);
+        return this->file_loc + ByteLoc(ptr - this->file_begin);
+    }
+
+    /// Same as `location_for_ptr`, except that it goes through the source map,
+    /// which checks that `ptr` is really in the file map being scanned.
+    auto checked_location_for_ptr(const char *ptr) const -> ByteLoc
     {
         return this->source_map.ptr_to_byteloc(this->file_loc, ptr);
     }
@@ -123,24 +149,44 @@ public:
     static auto get_spelling_to_buffer(const Token &tok, char *spelling_buf,
                                        const SourceMap &map) -> size_t;
 
-    /// Converts the source range of a token to its correspoding lexeme.
+    /// Returns the lexeme of a token.
     //
-    /// This is similar to `get_spelling_to_buffer`, with the only addition that
-    /// the output buffer is a small vector.
+    /// Clean tokens, which have no escaped new-lines, trigraphs nor UCNs, are
+    /// spelled just like in source, so their lexeme is a view into the file
+    /// map and nothing is copied. Dirty tokens are converted into `out`, see
+    /// `get_spelling_to_buffer`. Either way, the lexeme isn't null-terminated.
     ///
     /// \param tok The token from which to get the lexeme.
-    /// \param[out] out The output buffer.
+    /// \param[out] out The buffer for the lexeme of dirty tokens.
     ///
-    /// \return A string view into the lexeme stored in the output buffer.
+    /// \return A string view into the lexeme.
     auto get_spelling(const Token &tok, small_vector_impl<char> &out) const
         -> std::string_view
     {
+        if (!tok.is_dirty()) [[likely]]
+            return source_text(tok);
         out.resize(tok.size());
         size_t spell_length =
             Scanner::get_spelling_to_buffer(tok, out.data(), this->source_map);
         return {out.data(), spell_length};
     }
 
+    /// Returns the source text of a token, as is.
+    //
+    /// Tokens from the file map being scanned are sliced straight out of it,
+    /// without looking up the source map.
+    auto source_text(const Token &tok) const -> std::string_view
+    {
+        const ByteLoc loc = tok.location();
+        if (loc >= this->file_loc &&
+            loc + ByteLoc(tok.size()) <= location_for_ptr(this->buffer_end))
+        {
+            const auto offset = static_cast<size_t>(loc - this->file_loc);
+            return {this->file_begin + offset, tok.size()};
+        }
+        return this->source_map.span_to_snippet(tok.source_span());
+    }
+
 private:
     auto try_read_ucn(const char *&start_ptr, const char *slash_ptr,
                       Token *tok = nullptr) -> uint32_t;
@@ -165,17 +211,19 @@ private:
     /// past it. This is used only by the internals of the lexical analysis.
     void form_token(Token &tok, const char *tok_end, TokenKind kind)
     {
+        cci_expects(buffer_ptr <= tok_end);
         tok.kind = kind;
-        tok.source_span = {location_for_ptr(buffer_ptr),
-                           location_for_ptr(tok_end)};
+        tok.set_source_span(
+            {location_for_ptr(buffer_ptr), location_for_ptr(tok_end)});
+        cci_ensures(tok.location() + ByteLoc(tok.size()) ==
+                    checked_location_for_ptr(tok_end));
         buffer_ptr = tok_end;
     }
 
     auto report(const char *loc_ptr, diag::Diag msg) const
         -> diag::DiagnosticBuilder
     {
-        return this->diag_handler.report(
-            this->source_map.ptr_to_byteloc(this->file_loc, loc_ptr), msg);
+        return this->diag_handler.report(location_for_ptr(loc_ptr), msg);
     }
 };
 
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "cci/syntax/source_map.hpp"
+#include "cci/util/batch_read.hpp"
+#include "cci/util/filesystem.hpp"
+#include "cci/util/span.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cci::syntax {
+
+/// A cache of source files, shared by any number of source maps.
+//
+/// Source files are immutable and reference counted, so every source map
+/// that loads a file through the cache shares the same contents, and the same
+/// line and multibyte character tables, while placing them at byte locations
+/// of its own with `SourceMap::add_filemap`. Memory thus grows with the number
+/// of unique files rather than with the number of source maps.
+///
+/// Files are keyed by their absolute path, and a cached file is reused for as
+/// long as its modification time and size don't change. Optionally, a file
+/// whose stamp did change is read and compared against the cached contents,
+/// so that files that are regenerated or touched without being modified keep
+/// their tables.
+///
+/// It's safe to use a cache from many threads at once.
+struct SourceFileCache
+{
+private:
+    /// What's checked to tell whether a cached file is still up to date.
+    struct FileStamp
+    {
+        fs::file_time_type mtime;
+        uintmax_t size = 0;
+
+        bool operator==(const FileStamp &) const = default;
+    };
+
+    struct Entry
+    {
+        FileStamp stamp;
+        size_t content_hash = 0;
+        std::shared_ptr<const SourceFile> file;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    bool compare_contents;
+
+    /// Returns the key of the file at `file_path`.
+    static auto cache_key(const fs::path &file_path) -> std::string;
+
+    /// Returns the stamp of the file at `file_path`, or nothing if it doesn't
+    /// exist.
+    static auto file_stamp(const fs::path &file_path)
+        -> std::optional<FileStamp>;
+
+    /// Returns the cached file for `key` if its stamp is still `stamp`.
+    auto find(const std::string &key, const FileStamp &stamp) const
+        -> std::shared_ptr<const SourceFile>;
+
+    /// Caches a newly read source file, unless its contents are the same as
+    /// the cached ones, in which case those are kept. Returns the file that
+    /// ends up in the cache.
+    auto insert(std::string key, FileStamp stamp,
+                std::shared_ptr<const SourceFile> file)
+        -> std::shared_ptr<const SourceFile>;
+
+public:
+    /// Constructs an empty cache.
+    //
+    /// \param compare_contents Whether files whose modification time or size
+    ///                         changed are compared against the cached
+    ///                         contents before replacing them.
+    explicit SourceFileCache(bool compare_contents = false)
+        : compare_contents(compare_contents)
+    {}
+
+    SourceFileCache(const SourceFileCache &) = delete;
+    SourceFileCache &operator=(const SourceFileCache &) = delete;
+
+    /// Loads the file at `file_path`, or returns it from the cache if it's up
+    /// to date.
+    //
+    /// Cached files are read into memory rather than mapped, as they may
+    /// outlive any changes to the files on disk.
+    ///
+    /// \return The source file, or null if it couldn't be read.
+    auto load(const fs::path &file_path) -> std::shared_ptr<const SourceFile>;
+
+    /// Loads many files at once, reading the ones that aren't cached or up to
+    /// date concurrently, see `read_streams_utf8`.
+    //
+    /// \return The source files, in the same order as `file_paths`, where
+    ///         files that couldn't be read are null.
+    auto load_all(span<const fs::path> file_paths,
+                  BatchReadBackend backend = BatchReadBackend::automatic)
+        -> std::vector<std::shared_ptr<const SourceFile>>;
+
+    /// Returns the number of cached files.
+    auto size() const -> size_t;
+
+    /// Drops all cached files. Source maps keep the ones they're using.
+    void clear();
+};
+
+} // namespace cci::syntax
@@ -1,9 +1,15 @@
 #pragma once
 
+#include "cci/util/batch_read.hpp"
 #include "cci/util/contracts.hpp"
+#include "cci/util/filesystem.hpp"
+#include "cci/util/mapped_file.hpp"
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <type_traits>
@@ -13,8 +19,19 @@ namespace cci::syntax {
 
 struct FileMap;
 
+/// Integer type of byte locations and character positions.
+//
+/// All sources of a `SourceMap` must fit in 4 GiB of byte locations, unless
+/// built with `CCI_WIDE_SOURCE_LOCATIONS`, which widens locations to 64 bits
+/// at the cost of doubling the size of every location and span.
+#if CCI_WIDE_SOURCE_LOCATIONS
+using SourceLocInt = uint64_t;
+#else
+using SourceLocInt = uint32_t;
+#endif
+
 /// A byte offset that represents a byte location of a source code.
-enum class ByteLoc : uint32_t
+enum class ByteLoc : SourceLocInt
 {
 };
 
@@ -34,7 +51,7 @@ inline constexpr ByteLoc operator-(ByteLoc lhs, ByteLoc rhs) noexcept
 //
 /// A character offset is not equivalent to a byte offset, because UTF-8
 /// characters are multibyte.
-enum class CharPos : uint32_t
+enum class CharPos : SourceLocInt
 {
 };
 
@@ -82,18 +99,150 @@ struct SourceLoc
 static_assert(std::is_trivially_copyable_v<ByteLoc>);
 static_assert(std::is_trivially_copyable_v<CharPos>);
 static_assert(std::is_trivially_copyable_v<ByteSpan>);
+static_assert(sizeof(ByteSpan) == 2 * sizeof(ByteLoc),
+              "byte spans must not be padded");
+
+/// The contents of a source file.
+//
+/// A source file knows nothing about where it's placed in a `SourceMap`, so
+/// all of its tables are in byte offsets from its start. It's immutable once
+/// constructed, which allows a single source file to be shared between many
+/// source maps, and across threads.
+struct SourceFile
+{
+private:
+    /// Line and multibyte character tables of the source code.
+    //
+    /// Most files never have a location resolved into a line and column, so
+    /// these are only built the first time they're needed.
+    struct SourceIndex
+    {
+        std::once_flag built;
+        std::atomic<bool> is_built = false;
+
+        std::vector<ByteLoc> lines;
+        std::vector<std::pair<ByteLoc, size_t>> multibyte_chars;
+        std::vector<size_t> multibyte_extra_bytes;
+    };
+
+    mutable SourceIndex index;
+
+    /// Storage of the source code, which is either owned by this source file
+    /// or mapped from a file. `src` points into one of them, so source files
+    /// can't be moved.
+    std::string owned_src;
+    MappedFile mapped_src;
+
+    /// The source code, past any byte order mark, and ending with a newline
+    /// unless it's empty. It's always followed by a null character.
+    std::string_view src;
+
+    /// Builds the index if it hasn't been built yet, and returns it.
+    auto source_index() const -> const SourceIndex &;
+
+    /// Computes the line and multibyte character tables into `index`.
+    void build_index(SourceIndex &index) const;
+
+    /// Sets up `src` to view `buffer`.
+    void init_src(std::string_view buffer);
+
+public:
+    std::string name;
+
+    /// Constructs a source file from its contents.
+    //
+    /// Line and multibyte character offsets are computed lazily, the first
+    /// time any of them is needed.
+    ///
+    /// \param name The file name.
+    /// \param src The source code content.
+    SourceFile(std::string name, std::string src);
+
+    /// Constructs a source file that reads the pages of a mapped file in
+    /// place, without copying them.
+    //
+    /// \param name The file name.
+    /// \param src The mapped source code content.
+    SourceFile(std::string name, MappedFile src);
+
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+
+    /// Returns the byte offsets of the start of all lines in the source code.
+    auto lines() const -> const std::vector<ByteLoc> &
+    {
+        return source_index().lines;
+    }
+
+    /// Returns the byte offsets and sizes of all multibyte characters.
+    auto multibyte_chars() const
+        -> const std::vector<std::pair<ByteLoc, size_t>> &
+    {
+        return source_index().multibyte_chars;
+    }
+
+    /// Returns the running total of the extra bytes taken by multibyte
+    /// characters, i.e. the Nth element is how many bytes more than
+    /// characters there are up to and including the Nth multibyte character.
+    auto multibyte_extra_bytes() const -> const std::vector<size_t> &
+    {
+        return source_index().multibyte_extra_bytes;
+    }
+
+    /// Returns whether the line and multibyte character tables have been
+    /// built already.
+    auto has_source_index() const -> bool
+    {
+        return this->index.is_built.load(std::memory_order_acquire);
+    }
+
+    /// Returns whether the source code is read in place from a mapped file.
+    auto is_mapped() const -> bool { return this->mapped_src.data(); }
+
+    /// Returns a line from the list of precomputed line-beginnings.
+    auto get_line(size_t line_index) const -> std::string_view;
+
+    /// Returns the index of the line containing the byte at `offset`.
+    auto lookup_line_idx(ByteLoc offset) const -> size_t;
+
+    /// Converts a byte offset into a character offset. This takes
+    /// logarithmic time in the number of multibyte characters.
+    //
+    /// \param offset A byte offset into this source file that isn't in the
+    ///               middle of a multibyte character.
+    auto offset_to_charpos(ByteLoc offset) const -> CharPos;
+
+    /// Returns the size in bytes of the source code.
+    auto size() const -> size_t { return src.size(); }
+
+    /// Returns a string view of the source content.
+    auto src_view() const { return src; }
+
+    /// Returns an iterator to the beginning of the source content.
+    auto src_begin() const { return src.data(); }
+
+    /// Returns an iterator to the end of the source content, which always
+    /// points to a null character.
+    auto src_end() const { return src.data() + src.size(); }
+};
 
 /// A single source in the SourceMap.
 //
 /// A file map represents a source code, e.g. header files, source files etc.
 /// It's used by the `SourceMap` to organize the mapping between the AST and the
 /// source code.
+///
+/// The contents themselves are a shared `SourceFile`, which a file map places
+/// at a range of byte locations of its source map.
 struct FileMap
 {
-    // FIXME: Storing the source here is slow and temporary. Use a buffer for
-    // this in the `SourceMap`.
-    std::string name;
-    std::string src;
+private:
+    friend struct SourceMap;
+
+    std::shared_ptr<const SourceFile> file;
+
+public:
+    std::string_view name; ///< The file name, owned by the source file.
 
     /// The absolute start byte location of this file in a `SourceMap`.
     ByteLoc start_loc;
@@ -101,32 +250,48 @@ struct FileMap
     /// The absolute end byte location of this file in a `SourceMap`.
     ByteLoc end_loc;
 
-    /// Byte locations of the start of all lines in the source code.
-    std::vector<ByteLoc> lines;
-
-    /// Byte locations and sizes of all multibyte characters.
-    std::vector<std::pair<ByteLoc, size_t>> multibyte_chars;
-
     /// Constructs a `FileMap` to be processed by a `SourceMap`.
     //
-    /// Line and multibyte character locations are computed here.
-    ///
-    /// \param name The file name.
-    /// \param src The source code content.
+    /// \param file The contents of the file.
     /// \param start_loc The starting byte location for this file map.
-    FileMap(std::string name, std::string src, ByteLoc start_loc);
+    FileMap(std::shared_ptr<const SourceFile> file, ByteLoc start_loc);
 
     FileMap(const FileMap &) = delete;
     FileMap &operator=(const FileMap &) = delete;
 
-    FileMap(FileMap &&) = default;
-    FileMap &operator=(FileMap &&) = default;
+    /// Returns the contents of this file map.
+    auto source_file() const -> const SourceFile & { return *file; }
+
+    /// Returns the contents of this file map, for sharing them with others.
+    auto shared_source_file() const -> const std::shared_ptr<const SourceFile> &
+    {
+        return file;
+    }
 
     /// Returns a line from the list of precomputed line-beginnings.
-    auto get_line(size_t line_index) const -> std::string_view;
+    auto get_line(size_t line_index) const -> std::string_view
+    {
+        return file->get_line(line_index);
+    }
 
     /// Returns the line index corresponding to `loc`.
-    auto lookup_line_idx(ByteLoc loc) const -> size_t;
+    auto lookup_line_idx(ByteLoc loc) const -> size_t
+    {
+        cci_expects(this->contains(loc));
+        return file->lookup_line_idx(loc - start_loc);
+    }
+
+    /// Converts a byte location into a character position relative to the
+    /// start of this file map. This takes logarithmic time in the number of
+    /// multibyte characters.
+    //
+    /// \param loc A byte location within this file map that isn't in the
+    ///            middle of a multibyte character.
+    auto byteloc_to_charpos(ByteLoc loc) const -> CharPos
+    {
+        cci_expects(this->contains(loc));
+        return file->offset_to_charpos(loc - start_loc);
+    }
 
     /// Returns whether a byte location is contained in this FileMap.
     auto contains(ByteLoc loc) const -> bool
@@ -135,13 +300,30 @@ struct FileMap
     }
 
     /// Returns a string view of the source content.
-    auto src_view() const { return std::string_view(src); }
+    auto src_view() const { return file->src_view(); }
 
     /// Returns an iterator to the beginning of the source content.
-    auto src_begin() const { return src.data(); }
+    auto src_begin() const { return file->src_begin(); }
 
-    /// Returns an iterator to the end of the source content.
-    auto src_end() const { return src.data() + src.size(); }
+    /// Returns an iterator to the end of the source content, which always
+    /// points to a null character.
+    auto src_end() const { return file->src_end(); }
+};
+
+/// An edit of a file's source: the bytes in `[offset, offset + removed_size)`
+/// replaced by `replacement`.
+struct SourceEdit
+{
+    size_t offset = 0; ///< Offset of the edit from the start of the source.
+    size_t removed_size = 0; ///< Number of bytes replaced.
+    std::string_view replacement; ///< The bytes replacing them.
+
+    /// Returns by how much the edit moves the bytes past it.
+    auto size_delta() const -> std::ptrdiff_t
+    {
+        return static_cast<std::ptrdiff_t>(replacement.size()) -
+               static_cast<std::ptrdiff_t>(removed_size);
+    }
 };
 
 /// A set of FileMaps.
@@ -155,21 +337,116 @@ struct SourceMap
 private:
     std::vector<std::unique_ptr<FileMap>> file_maps;
 
+    /// Start locations of all file maps, in the same order as `file_maps`.
+    /// These are kept apart so that lookups can binary search over them
+    /// without chasing pointers.
+    std::vector<ByteLoc> start_locs;
+
+    /// Index of the last file map found by `lookup_filemap_idx`. Consecutive
+    /// lookups almost always land in the same file, e.g. when scanning it.
+    mutable std::atomic<size_t> last_filemap_idx = 0;
+
 public:
     SourceMap() = default;
 
     SourceMap(const SourceMap &) = delete;
     SourceMap &operator=(const SourceMap &) = delete;
 
-    SourceMap(SourceMap &&) = default;
-    SourceMap &operator=(SourceMap &&) = default;
+    SourceMap(SourceMap &&other) noexcept
+        : file_maps(std::move(other.file_maps))
+        , start_locs(std::move(other.start_locs))
+        , last_filemap_idx(other.last_filemap_idx.load())
+    {}
+
+    SourceMap &operator=(SourceMap &&other) noexcept
+    {
+        this->file_maps = std::move(other.file_maps);
+        this->start_locs = std::move(other.start_locs);
+        this->last_filemap_idx = other.last_filemap_idx.load();
+        return *this;
+    }
+
+    /// Constructs a new internal `FileMap` for the contents of `file`. Start
+    /// and end locations are calculated based on previous existing FileMaps.
+    //
+    /// The source file may be shared with other source maps, each of which
+    /// places it at locations of its own.
+    auto add_filemap(std::shared_ptr<const SourceFile> file)
+        -> const FileMap &;
 
     /// Constructs a new internal `FileMap` with `name` and `src`. Start and end
     /// locations are calculated based on previous existing FileMaps.
     auto create_owned_filemap(std::string name, std::string src)
         -> const FileMap &;
 
+    /// Constructs a new internal `FileMap` with `name` that reads its source
+    /// code in place from the mapped file `src`.
+    auto create_mapped_filemap(std::string name, MappedFile src)
+        -> const FileMap &;
+
+    /// Constructs a new internal `FileMap` with the source of `file` after
+    /// applying `edit` to it, and the same name.
+    //
+    /// The old file map stays valid, so that tokens lexed from it can be
+    /// carried over with `TokenBuffer::relex`. As every file map takes up as
+    /// many byte locations as its size, and all of them must fit in a
+    /// `ByteLoc`, this is only meant for a few edits. Use `update_filemap` to
+    /// apply edits one after another.
+    auto create_edited_filemap(const FileMap &file, const SourceEdit &edit)
+        -> const FileMap &;
+
+    /// Applies `edit` to the source of `file`, releasing the old source.
+    //
+    /// If `file` is the last file map, it's updated in place, keeping its
+    /// start location, so that a file edited over and over again takes up
+    /// neither more memory nor more byte locations. Otherwise, it's moved
+    /// to a new file map at the end, and `file` is left without a source:
+    /// neither it nor locations within it can be used anymore. Either way,
+    /// locations into the old source must not be looked up again, except
+    /// through `TokenBuffer::relex`, which only needs the edit.
+    ///
+    /// This must not be called concurrently with lookups.
+    ///
+    /// \return The file map with the edited source.
+    auto update_filemap(const FileMap &file, const SourceEdit &edit)
+        -> const FileMap &;
+
+    /// Size from which on `load_filemap` memory maps files.
+    //
+    /// Each mapping takes up a couple of the memory map areas of the process,
+    /// of which there are only so many, e.g. `vm.max_map_count` on Linux, so
+    /// smaller files, which are read about as fast anyway, aren't mapped.
+    static constexpr size_t min_mapped_size = 16 * 1024;
+
+    /// Loads the file at `file_path` into a new internal `FileMap`.
+    //
+    /// The file is memory mapped if it's at least `min_mapped_size` bytes and
+    /// mapping is possible, and read into memory otherwise.
+    ///
+    /// \return The new file map, or null if the file couldn't be read.
+    auto load_filemap(const fs::path &file_path) -> const FileMap *;
+
+    /// Loads many files at once into new internal `FileMap`s, in order.
+    //
+    /// All files are read concurrently, see `read_streams_utf8`. File maps
+    /// are created as soon as the files before them are read, and their line
+    /// tables are built while later files are still being read, where they
+    /// would otherwise be waiting on I/O.
+    ///
+    /// \param file_paths The files to load.
+    /// \param backend How the files are read.
+    ///
+    /// \return The new file maps, in the same order as `file_paths`, where
+    ///         files that couldn't be read are null.
+    auto load_filemaps(span<const fs::path> file_paths,
+                       BatchReadBackend backend = BatchReadBackend::automatic)
+        -> std::vector<const FileMap *>;
+
     /// Lookups the FileMap index based on a global ByteLoc.
+    //
+    /// This takes logarithmic time in the number of file maps, or constant
+    /// time if `loc` is in the same file map as the previous lookup. It's
+    /// safe to call concurrently.
     auto lookup_filemap_idx(ByteLoc loc) const -> size_t;
 
     /// Lookups a FileMap based on a global ByteLoc.
@@ -189,6 +466,17 @@ public:
     /// For a global position, lookups the source location.
     auto lookup_source_location(ByteLoc loc) const -> SourceLoc;
 
+    /// Lookups the source locations of many global positions at once.
+    //
+    /// The positions are grouped by file map, and each file map's line and
+    /// multibyte character tables are walked once for all of its positions,
+    /// instead of being searched from the start for every one of them. This
+    /// is fastest when `locs` is already sorted.
+    ///
+    /// \return The source locations, in the same order as `locs`.
+    auto lookup_source_locations(span<const ByteLoc> locs) const
+        -> std::vector<SourceLoc>;
+
     /// Converts a ByteSpan of code into a string view.
     auto span_to_snippet(ByteSpan r) const -> std::string_view;
 
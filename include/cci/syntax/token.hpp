@@ -1,13 +1,15 @@
 #pragma once
 
 #include "cci/syntax/source_map.hpp"
+#include "cci/util/contracts.hpp"
+#include <cstdint>
 #include <string_view>
 
 namespace cci::syntax {
 
 // A token kind represents the category of a token, e.g. identifier,
 // keyword etc.
-enum class TokenKind
+enum class TokenKind : uint8_t
 {
     // Keywords
     kw_auto,
@@ -168,12 +170,23 @@ constexpr auto is_char_constant(TokenKind k) -> bool
 }
 
 // A representation of a token as described in the C11 standard.
+//
+// A token is its start location, a 32-bit length, the kind and the flags,
+// which is 12 bytes, or 16 with wide source locations. Tokens kept in bulk
+// are packed further by `TokenBuffer`.
 struct Token
 {
+private:
+    // Token's start location. This and the length come first so that the
+    // kind and flags pack right after them, whatever the width of byte
+    // locations.
+    ByteLoc start = ByteLoc(0);
+    // Token's size in source.
+    uint32_t length = 0;
+
+public:
     // Token's syntactic category, e.g. kw_return, identifier etc.
     TokenKind kind = TokenKind::unknown;
-    // Token's start and end locations on the source file (lexeme).
-    ByteSpan source_span;
 
     enum TokenFlags
     {
@@ -187,7 +200,7 @@ struct Token
     };
 
     Token() = default;
-    Token(TokenKind c, ByteSpan r) noexcept : kind(c), source_span(r) {}
+    Token(TokenKind c, ByteSpan r) : kind(c) { set_source_span(r); }
 
     // Checks whether this token is of category `k`.
     bool is(TokenKind k) const { return kind == k; }
@@ -203,15 +216,28 @@ struct Token
         return (is(ks) || ...);
     }
 
-    // Returns the source location at which this token starts.
-    auto location() const -> ByteLoc { return source_span.start; }
+    // Returns token's start and end locations on the source file (lexeme).
+    auto source_span() const -> ByteSpan
+    {
+        return {start, start + ByteLoc(length)};
+    }
 
-    // Returns the size of the token spelling in source.
-    auto size() const
+    // Sets token's start and end locations on the source file.
+    void set_source_span(ByteSpan span)
     {
-        return static_cast<size_t>(source_span.end - source_span.start);
+        cci_expects(span.start <= span.end);
+        cci_expects(static_cast<SourceLocInt>(span.end - span.start) <=
+                    UINT32_MAX);
+        start = span.start;
+        length = static_cast<uint32_t>(span.end - span.start);
     }
 
+    // Returns the source location at which this token starts.
+    auto location() const -> ByteLoc { return start; }
+
+    // Returns the size of the token spelling in source.
+    auto size() const -> size_t { return length; }
+
     void set_flags(TokenFlags fs) { flags |= fs; }
     void clear_flags(TokenFlags fs) { flags &= ~fs; }
 
@@ -219,9 +245,15 @@ struct Token
     bool is_dirty() const { return flags & TokenFlags::IsDirty; }
     bool is_literal() const { return flags & TokenFlags::IsLiteral; }
 
+    // Returns all of the token's flags as a bit set of `TokenFlags`.
+    auto flag_bits() const -> uint8_t { return flags; }
+
 private:
     // Token's flags.
     uint8_t flags = TokenFlags::None;
 };
 
+static_assert(sizeof(Token) <= sizeof(ByteLoc) + 2 * sizeof(uint32_t),
+              "tokens must be packed tightly");
+
 } // namespace cci::syntax
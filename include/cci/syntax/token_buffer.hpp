@@ -0,0 +1,234 @@
+#pragma once
+
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "cci/util/contracts.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cci::syntax {
+
+/// The whole token stream of a file, lexed up front.
+//
+/// Tokens are stored as a struct of arrays of 8 bytes per token: kinds and
+/// flags take a byte each, and source spans are kept as 32-bit offsets
+/// relative to the start of the file map and 16-bit lengths. Tokens too long
+/// for that, which are only ever huge literals, have their lengths kept on
+/// the side. The end-of-input token isn't stored; indexing past the last
+/// token yields it instead, just like `Scanner::next_token` does.
+struct TokenBuffer
+{
+private:
+    /// A token too long for `lengths`.
+    struct LongToken
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    /// Length of tokens whose actual length is in `long_tokens`.
+    static constexpr uint16_t long_length = UINT16_MAX;
+
+    ByteLoc file_loc; ///< Start location of the file map the tokens are from.
+
+    std::vector<uint8_t> kinds;
+    std::vector<uint32_t> offsets;
+    std::vector<uint16_t> lengths;
+    std::vector<uint8_t> flags;
+
+    /// Tokens whose length is `long_length`, in the same order as the tokens.
+    std::vector<LongToken> long_tokens;
+
+public:
+    /// Constructs an empty buffer for tokens of the file map starting at
+    /// `file_loc`.
+    explicit TokenBuffer(ByteLoc file_loc) : file_loc(file_loc) {}
+
+    /// Lexes all tokens from a `FileMap`.
+    //
+    /// \param file The file map to be scanned.
+    /// \param diag The diagnostics handler that will be used to report any
+    /// errors.
+    static auto lex(const FileMap &file, diag::Handler &diag) -> TokenBuffer;
+
+    /// Lexes all tokens that `scanner` has yet to return.
+    static auto lex_remaining(Scanner &scanner) -> TokenBuffer;
+
+    /// Lexes all tokens from a `FileMap` by splitting it into chunks that are
+    /// lexed concurrently.
+    //
+    /// Chunk boundaries are guessed by a quick pre-pass that looks for line
+    /// starts which are unlikely to be inside of a comment or literal. Each
+    /// chunk is then lexed on its own thread, and the results are stitched
+    /// together. A chunk whose tokens don't line up with the ones before it,
+    /// or that ran into lexical errors, is lexed again sequentially, so the
+    /// tokens and the diagnostics reported to `diag` are exactly the same as
+    /// the ones from `lex`.
+    ///
+    /// Spawning threads isn't free, so this is only worth it for files of at
+    /// least a few megabytes.
+    ///
+    /// \param file The file map to be scanned.
+    /// \param diag The diagnostics handler that will be used to report any
+    /// errors.
+    /// \param num_chunks The maximum number of chunks to split `file` into.
+    static auto lex_parallel(const FileMap &file, diag::Handler &diag,
+                             size_t num_chunks) -> TokenBuffer;
+
+    /// The tokens replaced by `relex`.
+    struct RelexedRange
+    {
+        size_t first = 0; ///< Index of the first token lexed again.
+        size_t num_removed = 0; ///< Number of tokens it replaced.
+        size_t num_inserted = 0; ///< Number of tokens it lexed.
+    };
+
+    /// Updates the tokens of a file map after an edit, lexing again only the
+    /// tokens around it.
+    //
+    /// Lexing restarts at the last token before the line the edit is on, and
+    /// stops as soon as a token starts past the edit where an old token did.
+    /// Tokens on the line itself may have been decided by looking ahead into
+    /// the edit through any number of escaped newlines, but the scanner never
+    /// looks past an actual line break. The scanner keeps no state other than
+    /// its position, so the old tokens from where it stops on are the same,
+    /// and are only moved by the size of the edit. Diagnostics are only
+    /// reported for the tokens lexed again.
+    ///
+    /// \param edited_file The file map of the edited source, see
+    ///                    `SourceMap::update_filemap`.
+    /// \param edit The edit, in offsets into the old source.
+    /// \param diag The diagnostics handler that will be used to report any
+    /// errors.
+    ///
+    /// \return The range of tokens that was replaced.
+    auto relex(const FileMap &edited_file, const SourceEdit &edit,
+               diag::Handler &diag) -> RelexedRange;
+
+    /// Appends a token, which must come from the same file map.
+    void push_back(const Token &tok)
+    {
+        cci_expects(tok.location() >= file_loc);
+        // Offsets and lengths stay 32-bit even with wide source locations.
+        cci_expects(static_cast<SourceLocInt>(tok.location() - file_loc) +
+                        tok.size() <=
+                    UINT32_MAX);
+        const auto offset = static_cast<uint32_t>(tok.location() - file_loc);
+        kinds.push_back(static_cast<uint8_t>(tok.kind));
+        offsets.push_back(offset);
+        if (tok.size() < long_length) [[likely]]
+            lengths.push_back(static_cast<uint16_t>(tok.size()));
+        else
+        {
+            cci_expects(long_tokens.empty() ||
+                        long_tokens.back().offset < offset);
+            lengths.push_back(long_length);
+            long_tokens.push_back({offset, static_cast<uint32_t>(tok.size())});
+        }
+        flags.push_back(tok.flag_bits());
+    }
+
+    /// Reserves storage for `num_tokens` tokens.
+    void reserve(size_t num_tokens)
+    {
+        kinds.reserve(num_tokens);
+        offsets.reserve(num_tokens);
+        lengths.reserve(num_tokens);
+        flags.reserve(num_tokens);
+    }
+
+    /// Returns the number of tokens, not counting the end-of-input one.
+    auto size() const -> size_t { return kinds.size(); }
+
+    /// Returns whether there are no tokens other than the end-of-input one.
+    auto empty() const -> bool { return kinds.empty(); }
+
+    /// Returns the kind of the token at `idx` without building the whole
+    /// token.
+    auto kind(size_t idx) const -> TokenKind
+    {
+        return idx < size() ? static_cast<TokenKind>(kinds[idx])
+                            : TokenKind::eof;
+    }
+
+    /// Returns the token at `idx`, or the end-of-input token if `idx` is past
+    /// the last token.
+    auto operator[](size_t idx) const -> Token
+    {
+        if (idx >= size())
+            return Token(TokenKind::eof, ByteSpan{});
+        const ByteLoc start = file_loc + ByteLoc(offsets[idx]);
+        Token tok(static_cast<TokenKind>(kinds[idx]),
+                  ByteSpan(start, start + ByteLoc(length(idx))));
+        tok.set_flags(static_cast<Token::TokenFlags>(flags[idx]));
+        return tok;
+    }
+
+private:
+    /// Returns the index of the first token starting at or after `offset`
+    /// bytes into the file map.
+    auto lower_bound(size_t offset) const -> size_t;
+
+    /// Returns the length of the token at `idx`.
+    auto length(size_t idx) const -> uint32_t
+    {
+        if (lengths[idx] != long_length) [[likely]]
+            return lengths[idx];
+        return long_tokens[long_token_idx(idx)].length;
+    }
+
+    /// Returns the index into `long_tokens` of the first long token at or
+    /// after the token at `idx`.
+    auto long_token_idx(size_t idx) const -> size_t;
+
+    /// Appends the tokens of `other`, starting from the one at `first`.
+    void append(const TokenBuffer &other, size_t first);
+
+    /// Replaces the tokens in `[first, last)` by all tokens of `other`.
+    void splice(size_t first, size_t last, const TokenBuffer &other);
+};
+
+static_assert(static_cast<int>(TokenKind::eof) <= UINT8_MAX,
+              "token kinds must fit into a byte");
+
+/// A position into a `TokenBuffer` with constant-time lookahead.
+struct TokenCursor
+{
+private:
+    const TokenBuffer *tokens;
+    size_t pos = 0;
+
+public:
+    explicit TokenCursor(const TokenBuffer &tokens) : tokens(&tokens) {}
+
+    /// Returns the token `lookahead` tokens ahead of the current one.
+    auto peek(size_t lookahead = 0) const -> Token
+    {
+        return (*tokens)[pos + lookahead];
+    }
+
+    /// Returns the kind of the token `lookahead` tokens ahead of the current
+    /// one.
+    auto peek_kind(size_t lookahead = 0) const -> TokenKind
+    {
+        return tokens->kind(pos + lookahead);
+    }
+
+    /// Returns the current token and advances past it. The cursor stays at
+    /// the end-of-input token once it is reached.
+    auto consume() -> Token
+    {
+        const Token tok = peek();
+        if (pos < tokens->size())
+            ++pos;
+        return tok;
+    }
+
+    /// Returns the index of the current token.
+    auto position() const -> size_t { return pos; }
+};
+
+} // namespace cci::syntax
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cci/util/filesystem.hpp"
+#include "cci/util/span.hpp"
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace cci {
+
+/// How `read_streams_utf8` issues its reads.
+enum class BatchReadBackend
+{
+    /// io_uring if the kernel supports it, a thread pool otherwise.
+    automatic,
+
+    /// A pool of threads, each of which reads one file at a time.
+    thread_pool,
+};
+
+/// Called by `read_streams_utf8` with the index of a file in the batch and
+/// its contents, or nothing if it couldn't be read.
+using BatchReadCallback =
+    std::function<void(size_t index, std::optional<std::string> contents)>;
+
+/// Reads the contents of many UTF-8 files at once.
+//
+/// All opens and reads are submitted up front through io_uring where it's
+/// available, and spread over a pool of threads doing `pread`s otherwise.
+/// Either way, many requests are in flight at a time, which hides most of the
+/// latency of cold caches and network file systems.
+///
+/// `on_read` is called on the calling thread for every file, as soon as it's
+/// read, and thus in no particular order. The remaining reads keep going
+/// while it runs, so it's the place to do any processing of the contents.
+///
+/// \param file_paths The files to read.
+/// \param on_read The callback receiving the contents of each file.
+/// \param backend How the reads are issued.
+void read_streams_utf8(span<const fs::path> file_paths,
+                       const BatchReadCallback &on_read,
+                       BatchReadBackend backend = BatchReadBackend::automatic);
+
+} // namespace cci
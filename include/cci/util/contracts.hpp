@@ -55,6 +55,8 @@ struct unreachable_exception : std::runtime_error
     (throw ::cci::unreachable_exception(                                       \
         "unreachable code reached at " __FILE__ ":" STRINGIFY(__LINE__)))
 
+} // namespace cci
+
 #else
 
 #define cci_expects(cond)
@@ -66,5 +68,3 @@ struct unreachable_exception : std::runtime_error
 #endif
 
 #endif // if CCI_CONTRACTS
-
-} // namespace cci
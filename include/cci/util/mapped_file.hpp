@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cci/util/filesystem.hpp"
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace cci {
+
+/// A read-only view of a file's contents mapped into memory.
+//
+/// The mapping is padded with at least `padding_size` zeroed bytes past the
+/// end of the file, so that the contents can be treated as a null-terminated
+/// buffer without copying them, and so that a missing trailing character can
+/// be appended in place. The mapping is private: writes to the padding never
+/// reach the file.
+struct MappedFile
+{
+private:
+    char *mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t file_size = 0;
+
+    MappedFile(char *mapping, size_t mapping_size, size_t file_size) noexcept
+        : mapping(mapping), mapping_size(mapping_size), file_size(file_size)
+    {}
+
+public:
+    /// Number of zeroed bytes guaranteed to follow the file contents.
+    static constexpr size_t padding_size = 2;
+
+    MappedFile() noexcept = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    /// Maps the contents of the file at `file_path`.
+    //
+    /// \return The mapped file, or nothing if the file couldn't be opened or
+    ///         mapped, or if memory mapping isn't supported on this platform.
+    static auto open(const fs::path &file_path) -> std::optional<MappedFile>;
+
+    /// Returns a pointer to the start of the mapped contents.
+    auto data() const -> const char * { return mapping; }
+
+    /// Returns the size in bytes of the mapped contents, not counting the
+    /// padding.
+    auto size() const -> size_t { return file_size; }
+
+    /// Returns a view of the mapped contents.
+    auto view() const -> std::string_view { return {mapping, file_size}; }
+
+    /// Appends a character into the padding right after the contents. There
+    /// must be room left for the null character that follows them, which is
+    /// always the case for the first `padding_size - 1` calls.
+    void append(char c);
+};
+
+} // namespace cci
@@ -0,0 +1,279 @@
+#include "cci/syntax/char_scan.hpp"
+#include "cci/syntax/char_info.hpp"
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CCI_CHAR_SCAN_AVX2 1
+#define CCI_CHAR_SCAN_SSE2 0
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CCI_CHAR_SCAN_AVX2 0
+#define CCI_CHAR_SCAN_SSE2 1
+#else
+#define CCI_CHAR_SCAN_AVX2 0
+#define CCI_CHAR_SCAN_SSE2 0
+#endif
+
+namespace cci::syntax {
+
+// The following few helpers abstract away the instruction set used to
+// classify a block of bytes, so each search only has to be written once.
+// A search builds a byte-wise mask for a block, where set bytes correspond to
+// interesting characters, and then turns it into a bit mask, where bit N
+// tells whether the Nth byte in the block is interesting.
+namespace {
+
+#if CCI_CHAR_SCAN_AVX2
+
+using Block = __m256i;
+using BlockMask = uint32_t;
+constexpr size_t block_size = 32;
+
+auto load_block(const char *ptr) -> Block
+{
+    return _mm256_loadu_si256(reinterpret_cast<const Block *>(ptr));
+}
+
+auto splat(char c) -> Block { return _mm256_set1_epi8(c); }
+auto bytes_eq(Block a, Block b) -> Block { return _mm256_cmpeq_epi8(a, b); }
+auto bytes_or(Block a, Block b) -> Block { return _mm256_or_si256(a, b); }
+auto bytes_sub(Block a, Block b) -> Block { return _mm256_sub_epi8(a, b); }
+auto bytes_min(Block a, Block b) -> Block { return _mm256_min_epu8(a, b); }
+
+auto bytes_negative(Block b) -> Block
+{
+    return _mm256_cmpgt_epi8(_mm256_setzero_si256(), b);
+}
+
+auto sum_bytes(Block b) -> size_t
+{
+    const Block sums = _mm256_sad_epu8(b, _mm256_setzero_si256());
+    return static_cast<size_t>(
+        _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+        _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3));
+}
+
+auto to_mask(Block b) -> BlockMask
+{
+    return static_cast<BlockMask>(_mm256_movemask_epi8(b));
+}
+
+#elif CCI_CHAR_SCAN_SSE2
+
+using Block = __m128i;
+using BlockMask = uint32_t;
+constexpr size_t block_size = 16;
+
+auto load_block(const char *ptr) -> Block
+{
+    return _mm_loadu_si128(reinterpret_cast<const Block *>(ptr));
+}
+
+auto splat(char c) -> Block { return _mm_set1_epi8(c); }
+auto bytes_eq(Block a, Block b) -> Block { return _mm_cmpeq_epi8(a, b); }
+auto bytes_or(Block a, Block b) -> Block { return _mm_or_si128(a, b); }
+auto bytes_sub(Block a, Block b) -> Block { return _mm_sub_epi8(a, b); }
+auto bytes_min(Block a, Block b) -> Block { return _mm_min_epu8(a, b); }
+
+auto bytes_negative(Block b) -> Block
+{
+    return _mm_cmplt_epi8(b, _mm_setzero_si128());
+}
+
+auto sum_bytes(Block b) -> size_t
+{
+    const Block sums = _mm_sad_epu8(b, _mm_setzero_si128());
+    const Block high = _mm_unpackhi_epi64(sums, sums);
+    return static_cast<size_t>(_mm_cvtsi128_si64(sums) +
+                               _mm_cvtsi128_si64(high));
+}
+
+auto to_mask(Block b) -> BlockMask
+{
+    return static_cast<BlockMask>(_mm_movemask_epi8(b));
+}
+
+#endif
+
+#if CCI_CHAR_SCAN_AVX2 || CCI_CHAR_SCAN_SSE2
+
+constexpr BlockMask full_block_mask =
+    static_cast<BlockMask>((uint64_t(1) << block_size) - 1);
+
+// Index of the lowest set bit of a non-zero mask.
+auto first_set(BlockMask mask) -> size_t
+{
+    return static_cast<size_t>(__builtin_ctz(mask));
+}
+
+// Marks bytes in a block that have their high bit set. That's exactly the
+// sign bit the mask is made of, so no comparison is needed.
+auto non_ascii_mask(Block b) -> BlockMask { return to_mask(b); }
+
+// Marks whitespace bytes in a block. '\t', '\n', '\v', '\f' and '\r' are
+// contiguous in ASCII (0x09 to 0x0D), so a range check covers them.
+auto whitespace_mask(Block b) -> BlockMask
+{
+    const Block spaces = bytes_eq(b, splat(' '));
+    const Block rebased = bytes_sub(b, splat('\t'));
+    const Block controls = bytes_eq(bytes_min(rebased, splat(4)), rebased);
+    return to_mask(bytes_or(spaces, controls));
+}
+
+// Marks bytes in a block that are equal to any of `Cs`.
+template <char C, char... Cs>
+auto bytes_eq_any(Block b) -> Block
+{
+    if constexpr (sizeof...(Cs) == 0)
+        return bytes_eq(b, splat(C));
+    else
+        return bytes_or(bytes_eq(b, splat(C)), bytes_eq_any<Cs...>(b));
+}
+
+#endif
+
+template <char... Cs>
+auto find_first_of_scalar(const char *ptr, const char *end) -> const char *
+{
+    return std::find_if(ptr, end, [](char c) { return ((c == Cs) || ...); });
+}
+
+template <char... Cs>
+auto find_first_of(const char *ptr, const char *end) -> const char *
+{
+#if CCI_CHAR_SCAN_AVX2 || CCI_CHAR_SCAN_SSE2
+    for (; end - ptr >= static_cast<ptrdiff_t>(block_size); ptr += block_size)
+    {
+        const BlockMask found = to_mask(bytes_eq_any<Cs...>(load_block(ptr)));
+        if (found != 0)
+            return ptr + first_set(found);
+    }
+#endif
+    return find_first_of_scalar<Cs...>(ptr, end);
+}
+
+} // namespace
+
+const size_t char_scan_block_size =
+#if CCI_CHAR_SCAN_AVX2 || CCI_CHAR_SCAN_SSE2
+    block_size;
+#else
+    1;
+#endif
+
+auto skip_whitespace_scalar(const char *ptr, const char *end) -> const char *
+{
+    return std::find_if_not(ptr, end, is_whitespace);
+}
+
+auto skip_whitespace(const char *ptr, const char *end) -> const char *
+{
+#if CCI_CHAR_SCAN_AVX2 || CCI_CHAR_SCAN_SSE2
+    // Runs of one or two characters are the most common ones, and loading a
+    // block for them is slower than just looking at them.
+    for (const char *short_run_end = ptr + std::min<ptrdiff_t>(end - ptr, 4);
+         ptr != short_run_end; ++ptr)
+    {
+        if (!is_whitespace(*ptr))
+            return ptr;
+    }
+
+    for (; end - ptr >= static_cast<ptrdiff_t>(block_size); ptr += block_size)
+    {
+        const BlockMask non_whitespace =
+            ~whitespace_mask(load_block(ptr)) & full_block_mask;
+        if (non_whitespace != 0)
+            return ptr + first_set(non_whitespace);
+    }
+#endif
+    return skip_whitespace_scalar(ptr, end);
+}
+
+auto find_line_comment_stop(const char *ptr, const char *end) -> const char *
+{
+    return find_first_of<'\n', '\r', '\0', '\\', '?'>(ptr, end);
+}
+
+auto find_line_comment_stop_scalar(const char *ptr, const char *end)
+    -> const char *
+{
+    return find_first_of_scalar<'\n', '\r', '\0', '\\', '?'>(ptr, end);
+}
+
+auto find_block_comment_stop(const char *ptr, const char *end) -> const char *
+{
+    return find_first_of<'/', '\0', '\\', '?'>(ptr, end);
+}
+
+auto find_block_comment_stop_scalar(const char *ptr, const char *end)
+    -> const char *
+{
+    return find_first_of_scalar<'/', '\0', '\\', '?'>(ptr, end);
+}
+
+auto count_newlines_and_non_ascii(const char *ptr, const char *end)
+    -> ByteCounts
+{
+    ByteCounts counts;
+#if CCI_CHAR_SCAN_AVX2 || CCI_CHAR_SCAN_SSE2
+    // Matches are counted per lane by subtracting the comparison results,
+    // which are -1 for matching bytes, and lanes are summed up before they
+    // can overflow.
+    while (end - ptr >= static_cast<ptrdiff_t>(block_size))
+    {
+        Block newlines = splat(0);
+        Block non_ascii = splat(0);
+        for (int i = 0;
+             i < 255 && end - ptr >= static_cast<ptrdiff_t>(block_size);
+             ++i, ptr += block_size)
+        {
+            const Block b = load_block(ptr);
+            newlines = bytes_sub(newlines, bytes_eq(b, splat('\n')));
+            non_ascii = bytes_sub(non_ascii, bytes_negative(b));
+        }
+        counts.newlines += sum_bytes(newlines);
+        counts.non_ascii += sum_bytes(non_ascii);
+    }
+#endif
+    const ByteCounts tail = count_newlines_and_non_ascii_scalar(ptr, end);
+    counts.newlines += tail.newlines;
+    counts.non_ascii += tail.non_ascii;
+    return counts;
+}
+
+auto count_newlines_and_non_ascii_scalar(const char *ptr, const char *end)
+    -> ByteCounts
+{
+    ByteCounts counts;
+    for (; ptr != end; ++ptr)
+    {
+        counts.newlines += *ptr == '\n';
+        counts.non_ascii += !is_ascii(*ptr);
+    }
+    return counts;
+}
+
+auto classify_line_chunk(const char *ptr) -> LineChunkMasks
+{
+    LineChunkMasks masks;
+#if CCI_CHAR_SCAN_AVX2 || CCI_CHAR_SCAN_SSE2
+    static_assert(line_chunk_size % block_size == 0);
+    for (size_t i = 0; i < line_chunk_size; i += block_size)
+    {
+        const Block b = load_block(ptr + i);
+        masks.newlines |= uint64_t(to_mask(bytes_eq(b, splat('\n')))) << i;
+        masks.non_ascii |= uint64_t(non_ascii_mask(b)) << i;
+    }
+#else
+    for (size_t i = 0; i < line_chunk_size; ++i)
+    {
+        masks.newlines |= uint64_t(ptr[i] == '\n') << i;
+        masks.non_ascii |= uint64_t(!is_ascii(ptr[i])) << i;
+    }
+#endif
+    return masks;
+}
+
+} // namespace cci::syntax
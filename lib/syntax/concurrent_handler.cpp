@@ -0,0 +1,217 @@
+#include "cci/syntax/concurrent_handler.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+namespace cci::diag {
+
+/// A single-producer single-consumer queue of diagnostics.
+//
+/// The queue is a list of blocks. The producer fills the last block and
+/// publishes how many entries it has filled, and links a new block when it's
+/// full. The consumer reads the published entries of the first block, and
+/// frees the block once it has read all of it and a next one is linked. The
+/// producer closes the queue once it's done, after which the consumer frees
+/// the whole queue as soon as it has read the rest of it.
+struct ConcurrentHandler::Queue
+{
+    static constexpr size_t block_size = 32;
+
+    struct Block
+    {
+        std::atomic<size_t> size = 0;
+        std::atomic<Block *> next = nullptr;
+        std::array<std::optional<Diagnostic>, block_size> entries;
+    };
+
+    /// Translation unit of the queued diagnostics.
+    const size_t tu;
+
+    /// Next queue of the handler.
+    Queue *next_queue = nullptr;
+
+    /// Whether the producer is done pushing.
+    std::atomic<bool> closed = false;
+
+    /// Block being filled, only accessed by the producer.
+    Block *tail;
+
+    /// Block being read and how much of it has been, only accessed by the
+    /// consumer.
+    Block *head;
+    size_t read_pos = 0;
+
+    explicit Queue(size_t tu) : tu(tu), tail(new Block), head(tail) {}
+
+    Queue(const Queue &) = delete;
+    Queue &operator=(const Queue &) = delete;
+
+    ~Queue()
+    {
+        while (head)
+            delete std::exchange(head, head->next.load());
+    }
+
+    void push(const Diagnostic &diag)
+    {
+        size_t size = this->tail->size.load(std::memory_order_relaxed);
+        if (size == block_size)
+        {
+            // The producer never touches the full block again, so the
+            // consumer may free it as soon as it sees the new one.
+            auto *block = new Block;
+            this->tail->next.store(block, std::memory_order_release);
+            this->tail = block;
+            size = 0;
+        }
+        this->tail->entries[size].emplace(diag);
+        this->tail->size.store(size + 1, std::memory_order_release);
+    }
+
+    void pop_all(std::vector<Pending> &out)
+    {
+        while (true)
+        {
+            const size_t size =
+                this->head->size.load(std::memory_order_acquire);
+            for (; this->read_pos < size; ++this->read_pos)
+            {
+                auto &entry = this->head->entries[this->read_pos];
+                out.push_back(Pending{this->tu, std::move(*entry)});
+                entry.reset();
+            }
+
+            if (this->read_pos < block_size)
+                return;
+            Block *next = this->head->next.load(std::memory_order_acquire);
+            if (!next)
+                return;
+            delete std::exchange(this->head, next);
+            this->read_pos = 0;
+        }
+    }
+};
+
+ConcurrentHandler::~ConcurrentHandler()
+{
+    Queue *queue = this->queues.load();
+    while (queue)
+        delete std::exchange(queue, queue->next_queue);
+}
+
+auto ConcurrentHandler::make_emitter(size_t tu) -> Handler::Emitter
+{
+    auto *queue = new Queue(tu);
+    queue->next_queue = this->queues.load(std::memory_order_relaxed);
+    while (!this->queues.compare_exchange_weak(queue->next_queue, queue,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed))
+    {}
+
+    // Copies of the emitter share the producer's end of the queue, which
+    // closes it rather than freeing it once the last of them is gone.
+    std::shared_ptr<Queue> producer(queue, [](Queue *q) {
+        q->closed.store(true, std::memory_order_release);
+    });
+    return [producer = std::move(producer)](const Diagnostic &diag) {
+        producer->push(diag);
+    };
+}
+
+void ConcurrentHandler::collect()
+{
+    Queue *prev = nullptr;
+    Queue *queue = this->queues.load(std::memory_order_acquire);
+    while (queue)
+    {
+        // Whatever was pushed before the queue was closed is read below.
+        const bool closed = queue->closed.load(std::memory_order_acquire);
+        queue->pop_all(this->pending);
+        Queue *next = queue->next_queue;
+        if (closed)
+        {
+            prev = unlink(queue, prev);
+            delete queue;
+        }
+        else
+            prev = queue;
+        queue = next;
+    }
+}
+
+auto ConcurrentHandler::unlink(Queue *queue, Queue *prev) -> Queue *
+{
+    if (prev)
+    {
+        prev->next_queue = queue->next_queue;
+        return prev;
+    }
+
+    Queue *first = queue;
+    if (this->queues.compare_exchange_strong(first, queue->next_queue,
+                                             std::memory_order_acquire))
+        return nullptr;
+
+    // New queues were linked in front of this one meanwhile.
+    prev = first;
+    while (prev->next_queue != queue)
+        prev = prev->next_queue;
+    prev->next_queue = queue->next_queue;
+    return prev;
+}
+
+auto ConcurrentHandler::queue_count() const -> size_t
+{
+    size_t count = 0;
+    for (Queue *queue = this->queues.load(std::memory_order_acquire); queue;
+         queue = queue->next_queue)
+        ++count;
+    return count;
+}
+
+void ConcurrentHandler::emit_finished(size_t tu_end)
+{
+    this->collect();
+    const auto finished_end =
+        std::partition(this->pending.begin(), this->pending.end(),
+                       [&](const Pending &p) { return p.tu < tu_end; });
+
+    // Orders by translation unit and location. The rest only breaks ties, so
+    // that diagnostics reported at the same location still come out in the
+    // same order every time.
+    const auto span_less = [](syntax::ByteSpan a, syntax::ByteSpan b) {
+        return std::tie(a.start, a.end) < std::tie(b.start, b.end);
+    };
+    std::sort(this->pending.begin(), finished_end,
+              [&](const Pending &lhs, const Pending &rhs) {
+                  const auto &l = lhs.diag;
+                  const auto &r = rhs.diag;
+                  if (std::tie(lhs.tu, l.loc, l.msg) !=
+                      std::tie(rhs.tu, r.loc, r.msg))
+                      return std::tie(lhs.tu, l.loc, l.msg) <
+                             std::tie(rhs.tu, r.loc, r.msg);
+                  if (l.args != r.args)
+                      return l.args < r.args;
+                  return std::lexicographical_compare(
+                      l.ranges.begin(), l.ranges.end(), r.ranges.begin(),
+                      r.ranges.end(), span_less);
+              });
+
+    for (auto it = this->pending.begin(); it != finished_end; ++it)
+    {
+        this->emitter(it->diag);
+        ++this->num_emitted;
+    }
+    this->pending.erase(this->pending.begin(), finished_end);
+}
+
+void ConcurrentHandler::emit_all()
+{
+    this->emit_finished(std::numeric_limits<size_t>::max());
+}
+
+} // namespace cci::diag
@@ -0,0 +1,489 @@
+#include "cci/syntax/diagnostic_stream.hpp"
+#include "cci/util/contracts.hpp"
+#include "cci/util/file_stream.hpp"
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
+namespace cci::diag2 {
+
+namespace {
+
+constexpr std::byte stream_magic[] = {std::byte('C'), std::byte('C'),
+                                      std::byte('I'), std::byte('D')};
+constexpr uint64_t stream_version = 1;
+
+enum class RecordKind : uint8_t
+{
+    file = 'F',
+    diagnostic = 'D',
+};
+
+constexpr uint64_t has_caret_flag = 1;
+
+void put_varint(std::vector<std::byte> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(std::byte((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(std::byte(value));
+}
+
+void put_bytes(std::vector<std::byte> &out, std::string_view bytes)
+{
+    put_varint(out, bytes.size());
+    const auto *data = reinterpret_cast<const std::byte *>(bytes.data());
+    out.insert(out.end(), data, data + bytes.size());
+}
+
+// Zigzag encoding keeps small negative numbers small.
+auto zigzag(int64_t value) -> uint64_t
+{
+    return (static_cast<uint64_t>(value) << 1) ^
+           static_cast<uint64_t>(value >> 63);
+}
+
+auto unzigzag(uint64_t value) -> int64_t
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/// Decodes a sequence of bytes of a stream. Reading past the end, or a
+/// malformed varint, makes the input fail, after which everything read is
+/// zero or empty.
+struct Input
+{
+    span<const std::byte> data;
+    size_t pos = 0;
+    bool failed = false;
+
+    auto size() const -> size_t { return static_cast<size_t>(data.size()); }
+    auto at_end() const -> bool { return this->pos == this->size(); }
+
+    auto varint() -> uint64_t
+    {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64 && !this->failed; shift += 7)
+        {
+            if (this->at_end())
+                break;
+            const auto byte =
+                std::to_integer<uint64_t>(this->data[this->pos++]);
+            value |= (byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        this->failed = true;
+        return 0;
+    }
+
+    auto u32() -> uint32_t
+    {
+        const uint64_t value = this->varint();
+        if (value > std::numeric_limits<uint32_t>::max())
+            this->failed = true;
+        return this->failed ? 0 : static_cast<uint32_t>(value);
+    }
+
+    auto int_value() -> int
+    {
+        const int64_t value = unzigzag(this->varint());
+        if (value < std::numeric_limits<int>::min() ||
+            value > std::numeric_limits<int>::max())
+            this->failed = true;
+        return this->failed ? 0 : static_cast<int>(value);
+    }
+
+    auto token_kind() -> syntax::TokenKind
+    {
+        const uint64_t value = this->varint();
+        if (value > static_cast<uint64_t>(syntax::TokenKind::eof))
+            this->failed = true;
+        return static_cast<syntax::TokenKind>(this->failed ? 0 : value);
+    }
+
+    auto bytes(size_t size) -> span<const std::byte>
+    {
+        if (this->failed || size > this->size() - this->pos)
+        {
+            this->failed = true;
+            return {};
+        }
+        this->pos += size;
+        return this->slice(this->pos - size, this->pos);
+    }
+
+    auto slice(size_t begin, size_t end) const -> span<const std::byte>
+    {
+        cci_expects(begin <= end && end <= this->size());
+        return {this->data.data() + begin, this->data.data() + end};
+    }
+
+    auto string() -> std::string_view
+    {
+        const auto str = this->bytes(this->varint());
+        return {reinterpret_cast<const char *>(str.data()),
+                static_cast<size_t>(str.size())};
+    }
+};
+
+// Appends the message of `descriptor` to `out`, replacing its placeholders
+// with the arguments returned by `get_arg` for their parameter index.
+template <typename GetArg>
+void render_message(const DiagnosticDescriptor &descriptor, GetArg &&get_arg,
+                    std::string &out)
+{
+    const std::string_view message = descriptor.message;
+    size_t pos = 0;
+    while (true)
+    {
+        const size_t open = message.find('{', pos);
+        const size_t close =
+            open == message.npos ? message.npos : message.find('}', open);
+        if (close == message.npos)
+            break;
+
+        out.append(message.substr(pos, open - pos));
+        const auto name = message.substr(open + 1, close - open - 1);
+        const auto index = descriptor.params.index_of(name);
+        const std::optional<DiagnosticArg> arg =
+            index ? get_arg(*index) : std::nullopt;
+        if (!arg)
+            out.append(message.substr(open, close - open + 1));
+        else if (const auto *str = arg->get_as<StrArg>())
+            out.append(str->value);
+        else if (const auto *tok = arg->get_as<TokenKindArg>())
+            out.append(syntax::to_string(tok->value));
+        else
+        {
+            char digits[16];
+            const auto int_arg = arg->get_as<IntArg>()->value;
+            const auto result =
+                std::to_chars(digits, digits + sizeof(digits), int_arg);
+            out.append(digits, result.ptr);
+        }
+        pos = close + 1;
+    }
+    out.append(message.substr(pos));
+}
+
+void render_location(std::string_view file_name, uint64_t line,
+                     uint64_t column, std::string &out)
+{
+    char digits[24];
+    out.append(file_name);
+    for (const uint64_t n : {line, column})
+    {
+        out.push_back(':');
+        const auto result = std::to_chars(digits, digits + sizeof(digits), n);
+        out.append(digits, result.ptr);
+    }
+    out.append(": ");
+}
+
+} // namespace
+
+void render_text(const Diagnostic &diag, const syntax::SourceMap &source_map,
+                 std::string &out)
+{
+    cci_expects(diag.descriptor);
+    if (diag.caret_location)
+    {
+        const auto loc =
+            source_map.lookup_source_location(*diag.caret_location);
+        render_location(loc.file.name, loc.line,
+                        static_cast<uint64_t>(loc.column) + 1, out);
+    }
+    render_message(
+        *diag.descriptor, [&](size_t index) { return diag.args[index]; }, out);
+    out.push_back('\n');
+}
+
+DiagnosticWriter::DiagnosticWriter(
+    const syntax::SourceMap &source_map,
+    span<const DiagnosticDescriptor *const> catalog)
+    : source_map(source_map)
+{
+    for (size_t i = 0; i < static_cast<size_t>(catalog.size()); ++i)
+        this->descriptor_ids.emplace(catalog[i], static_cast<uint32_t>(i));
+
+    this->stream.assign(std::begin(stream_magic), std::end(stream_magic));
+    put_varint(this->stream, stream_version);
+    put_varint(this->stream, catalog.size());
+}
+
+void DiagnosticWriter::write(const Diagnostic &diag)
+{
+    std::optional<syntax::SourceLoc> caret;
+    if (diag.caret_location)
+        caret.emplace(source_map.lookup_source_location(*diag.caret_location));
+    this->write(diag, caret);
+}
+
+void DiagnosticWriter::write(const DiagnosticBag &bag)
+{
+    std::vector<syntax::ByteLoc> caret_locs;
+    for (const Diagnostic &diag : bag)
+    {
+        if (diag.caret_location)
+            caret_locs.push_back(*diag.caret_location);
+    }
+
+    const auto carets = this->source_map.lookup_source_locations(caret_locs);
+    auto caret = carets.begin();
+    for (const Diagnostic &diag : bag)
+    {
+        this->write(diag, diag.caret_location
+                              ? std::optional<syntax::SourceLoc>(*caret++)
+                              : std::nullopt);
+    }
+}
+
+auto DiagnosticWriter::save(const fs::path &path) const -> bool
+{
+    return write_stream(path, this->stream.data(), this->stream.size());
+}
+
+void DiagnosticWriter::write(const Diagnostic &diag,
+                             const std::optional<syntax::SourceLoc> &caret)
+{
+    const auto descriptor_id = this->descriptor_ids.find(diag.descriptor);
+    cci_expects(descriptor_id != this->descriptor_ids.end());
+
+    // File records are appended to the stream while the diagnostic record is
+    // being put together, so they precede it.
+    std::vector<std::byte> &out = this->record;
+    out.clear();
+    put_varint(out, descriptor_id->second);
+    put_varint(out, caret ? has_caret_flag : 0);
+    if (caret)
+    {
+        const auto file = this->file_id(caret->file);
+        put_varint(out, file);
+        put_varint(out, static_cast<uint64_t>(*diag.caret_location -
+                                              caret->file.start_loc));
+        put_varint(out, caret->line);
+        put_varint(out, static_cast<uint64_t>(caret->column) + 1);
+    }
+
+    put_varint(out, diag.spans.size());
+    for (const syntax::ByteSpan span : diag.spans)
+    {
+        cci_expects(span.start <= span.end);
+        const auto &file = this->source_map.lookup_filemap(span.start);
+        cci_expects(file.contains(span.end));
+        put_varint(out, this->file_id(file));
+        put_varint(out, static_cast<uint64_t>(span.start - file.start_loc));
+        put_varint(out, static_cast<uint64_t>(span.end - span.start));
+    }
+
+    put_varint(out, static_cast<uint64_t>(std::count_if(
+                        diag.args.begin(), diag.args.end(),
+                        [](const auto &arg) { return arg.has_value(); })));
+    for (size_t i = 0; i < diag.args.size(); ++i)
+    {
+        if (!diag.args[i])
+            continue;
+        const DiagnosticArg &arg = *diag.args[i];
+        put_varint(out, i);
+        put_varint(out, static_cast<uint64_t>(arg.param_kind()));
+        if (const auto *str = arg.get_as<StrArg>())
+            put_bytes(out, str->value);
+        else if (const auto *tok = arg.get_as<TokenKindArg>())
+            put_varint(out, static_cast<uint64_t>(tok->value));
+        else
+            put_varint(out, zigzag(arg.get_as<IntArg>()->value));
+    }
+
+    this->stream.push_back(std::byte(RecordKind::diagnostic));
+    put_varint(this->stream, out.size());
+    this->stream.insert(this->stream.end(), out.begin(), out.end());
+}
+
+auto DiagnosticWriter::file_id(const syntax::FileMap &file) -> uint32_t
+{
+    const auto [it, inserted] = this->file_ids.try_emplace(
+        &file, static_cast<uint32_t>(this->file_ids.size()));
+    if (inserted)
+    {
+        this->stream.push_back(std::byte(RecordKind::file));
+        put_bytes(this->stream, file.name);
+    }
+    return it->second;
+}
+
+auto DiagnosticRecord::span_at(size_t index) const -> Span
+{
+    cci_expects(index < this->num_spans);
+    Input in{this->spans_data};
+    for (size_t i = 0;; ++i)
+    {
+        const uint32_t file = in.u32();
+        const uint32_t offset = in.u32();
+        const uint32_t size = in.u32();
+        if (i == index)
+        {
+            cci_expects(!in.failed && file < this->files->size());
+            Span span;
+            span.file_name = (*this->files)[file];
+            span.offset = offset;
+            span.size = size;
+            return span;
+        }
+    }
+}
+
+auto DiagnosticRecord::arg(size_t index) const -> std::optional<DiagnosticArg>
+{
+    Input in{this->args_data};
+    while (!in.at_end() && !in.failed)
+    {
+        const uint64_t param = in.varint();
+        const auto kind = static_cast<DiagnosticParamKind>(in.varint());
+        switch (kind)
+        {
+            case DiagnosticParamKind::Str:
+            {
+                const auto value = in.string();
+                if (param == index && !in.failed)
+                    return DiagnosticArg(StrArg(value));
+                break;
+            }
+            case DiagnosticParamKind::Int:
+            {
+                const auto value = in.int_value();
+                if (param == index && !in.failed)
+                    return DiagnosticArg(IntArg(value));
+                break;
+            }
+            case DiagnosticParamKind::TokenKind:
+            {
+                const auto value = in.token_kind();
+                if (param == index && !in.failed)
+                    return DiagnosticArg(TokenKindArg(value));
+                break;
+            }
+            default: return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+void DiagnosticRecord::render(std::string &out) const
+{
+    cci_expects(this->descriptor);
+    if (this->caret)
+    {
+        render_location(this->caret->file_name, this->caret->line,
+                        this->caret->column, out);
+    }
+    render_message(
+        *this->descriptor, [&](size_t index) { return this->arg(index); },
+        out);
+    out.push_back('\n');
+}
+
+DiagnosticReader::DiagnosticReader(
+    span<const std::byte> stream,
+    span<const DiagnosticDescriptor *const> catalog)
+    : stream(stream), catalog(catalog)
+{
+    Input in{stream};
+    const auto magic = in.bytes(sizeof(stream_magic));
+    const uint64_t version = in.varint();
+    const uint64_t catalog_size = in.varint();
+    this->malformed =
+        in.failed || !std::equal(magic.begin(), magic.end(), stream_magic) ||
+        version != stream_version ||
+        catalog_size > static_cast<size_t>(catalog.size());
+    this->pos = in.pos;
+}
+
+auto DiagnosticReader::next() -> std::optional<DiagnosticRecord>
+{
+    Input in{this->stream, this->pos};
+    while (true)
+    {
+        if (this->malformed || in.at_end())
+            return std::nullopt;
+
+        const auto kind = static_cast<RecordKind>(in.bytes(1)[0]);
+        if (kind == RecordKind::file)
+        {
+            const auto name = in.string();
+            if (in.failed)
+                break;
+            this->files.push_back(name);
+            continue;
+        }
+        if (kind != RecordKind::diagnostic)
+            break;
+
+        Input record{in.bytes(in.varint())};
+        DiagnosticRecord diag;
+        diag.files = &this->files;
+
+        const uint64_t descriptor_id = record.varint();
+        if (record.failed ||
+            descriptor_id >= static_cast<size_t>(this->catalog.size()))
+            break;
+        diag.descriptor = this->catalog[descriptor_id];
+
+        const uint64_t flags = record.varint();
+        if (flags & has_caret_flag)
+        {
+            const uint32_t file = record.u32();
+            if (file >= this->files.size())
+                break;
+            DiagnosticRecord::Caret caret;
+            caret.file_name = this->files[file];
+            caret.offset = record.u32();
+            caret.line = record.u32();
+            caret.column = record.u32();
+            diag.caret = caret;
+        }
+
+        // Spans and arguments are only checked for being in bounds, and for
+        // arguments fitting their kind, and decoded when they're asked for.
+        diag.num_spans = record.varint();
+        const size_t spans_begin = record.pos;
+        for (size_t i = 0; i < diag.num_spans && !record.failed; ++i)
+        {
+            if (record.u32() >= this->files.size())
+                record.failed = true;
+            record.u32();
+            record.u32();
+        }
+        diag.spans_data = record.slice(spans_begin, record.pos);
+
+        const uint64_t num_args = record.varint();
+        const size_t args_begin = record.pos;
+        for (size_t i = 0; i < num_args && !record.failed; ++i)
+        {
+            record.varint();
+            const auto kind = record.varint();
+            if (kind == static_cast<uint64_t>(DiagnosticParamKind::Str))
+                record.string();
+            else if (kind == static_cast<uint64_t>(DiagnosticParamKind::Int))
+                record.int_value();
+            else if (kind ==
+                     static_cast<uint64_t>(DiagnosticParamKind::TokenKind))
+                record.token_kind();
+            else
+                record.failed = true;
+        }
+        diag.args_data = record.slice(args_begin, record.pos);
+
+        if (record.failed || !record.at_end())
+            break;
+        this->pos = in.pos;
+        return diag;
+    }
+
+    this->malformed = true;
+    return std::nullopt;
+}
+
+} // namespace cci::diag2
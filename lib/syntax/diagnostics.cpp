@@ -1,10 +1,50 @@
 #include "cci/syntax/diagnostics.hpp"
+#include <memory>
+#include <new>
+#include <utility>
 
 namespace cci::diag {
 
 DiagnosticBuilder::~DiagnosticBuilder() noexcept(!CCI_CONTRACTS)
 {
-    this->handler->emit(std::move(diag));
+    if (this->slot)
+        this->handler->emit(*this->slot);
+}
+
+Handler::~Handler()
+{
+    // Slots live in the arena, which only frees their memory.
+    while (this->free_slots)
+        std::destroy_at(std::exchange(this->free_slots,
+                                      this->free_slots->next_free));
+}
+
+auto Handler::acquire(syntax::ByteLoc loc, Diag msg) -> DiagnosticSlot &
+{
+    if (!this->free_slots)
+    {
+        void *mem = this->arena.allocate(sizeof(DiagnosticSlot),
+                                         alignof(DiagnosticSlot));
+        return *new (mem) DiagnosticSlot{Diagnostic(source_map, loc, msg)};
+    }
+
+    // Clearing the vectors keeps their storage, in case a previous diagnostic
+    // spilled them to the heap.
+    DiagnosticSlot &slot = *std::exchange(this->free_slots,
+                                          this->free_slots->next_free);
+    slot.diag.loc = loc;
+    slot.diag.msg = msg;
+    slot.diag.ranges.clear();
+    slot.diag.args.clear();
+    slot.next_free = nullptr;
+    return slot;
+}
+
+void Handler::release(DiagnosticSlot &slot)
+{
+    cci_expects(!slot.next_free);
+    slot.next_free = this->free_slots;
+    this->free_slots = &slot;
 }
 
 auto ignoring_emitter() -> Handler::Emitter
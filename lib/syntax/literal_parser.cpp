@@ -2,13 +2,17 @@
 #include "cci/langopts.hpp"
 #include "cci/syntax/char_info.hpp"
 #include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/float_conversion.hpp"
 #include "cci/syntax/scanner.hpp"
 #include "cci/syntax/source_map.hpp"
 #include "cci/util/small_vector.hpp"
 #include "cci/util/span.hpp"
 #include "cci/util/unicode.hpp"
 #include <algorithm>
+#include <bit>
 #include <climits>
+#include <cstdint>
+#include <cstring>
 #include <utility>
 #include <vector>
 
@@ -47,36 +51,42 @@ NumericConstantParser::NumericConstantParser(Scanner &scanner,
                                              std::string_view tok_lexeme,
                                              ByteLoc tok_loc)
 {
-    cci_expects(tok_lexeme.end()[0] == '\0');
+    cci_expects(!tok_lexeme.empty());
     const char *const tok_begin = tok_lexeme.begin();
     const char *const tok_end = tok_lexeme.end();
     const char *s = tok_begin;
     digit_begin = tok_begin;
 
+    // The lexeme needn't be null-terminated, so this reads a null character
+    // past its end instead.
+    const auto at = [tok_end](const char *p) {
+        return p != tok_end ? *p : '\0';
+    };
+
     auto parse_possible_period_or_exponent = [&, this] {
         cci_expects(radix == 10 || radix == 8);
 
-        if (is_hexdigit(s[0]) && *s != 'e' && *s != 'E')
+        if (is_hexdigit(at(s)) && at(s) != 'e' && at(s) != 'E')
         {
             report(scanner, s, tok_loc, tok_begin, diag::Diag::invalid_digit);
             has_error = true;
             return;
         }
 
-        if (*s == '.')
+        if (at(s) == '.')
         {
             has_period = true;
             radix = 10;
             s = std::find_if_not(std::next(s), tok_end, is_digit);
         }
 
-        if (*s == 'e' || *s == 'E')
+        if (at(s) == 'e' || at(s) == 'E')
         {
             const auto exponent = s;
             ++s;
             has_exponent = true;
             radix = 10;
-            if (*s == '+' || *s == '-')
+            if (at(s) == '+' || at(s) == '-')
                 ++s; // optional sign
             const auto digs_start = s;
             s = std::find_if_not(s, tok_end, is_digit);
@@ -90,7 +100,7 @@ NumericConstantParser::NumericConstantParser(Scanner &scanner,
         }
     };
 
-    if (*s != '0')
+    if (at(s) != '0')
     {
         radix = 10;
         s = std::find_if_not(s, tok_end, is_digit);
@@ -100,24 +110,24 @@ NumericConstantParser::NumericConstantParser(Scanner &scanner,
     else
     {
         ++s;
-        if (*s == 'x' || *s == 'X')
+        if (at(s) == 'x' || at(s) == 'X')
         {
             radix = 16;
             std::advance(digit_begin, 2);
             s = std::find_if_not(std::next(s), tok_end, is_hexdigit);
 
-            if (s[0] == '.')
+            if (at(s) == '.')
             {
                 has_period = true;
                 s = std::find_if_not(std::next(s), tok_end, is_hexdigit);
             }
 
-            if (s[0] == 'p' || s[0] == 'P')
+            if (at(s) == 'p' || at(s) == 'P')
             {
                 const auto exponent = s;
                 ++s;
                 has_exponent = true;
-                if (s[0] == '+' || s[0] == '-')
+                if (at(s) == '+' || at(s) == '-')
                     ++s; // optional sign
                 const auto digs_start = s;
                 s = std::find_if_not(s, tok_end, is_digit);
@@ -146,7 +156,8 @@ NumericConstantParser::NumericConstantParser(Scanner &scanner,
                 {
                     const char *dec_end =
                         std::find_if_not(s, tok_end, is_digit);
-                    if (*dec_end == '.' || *dec_end == 'e' || *dec_end == 'E')
+                    if (at(dec_end) == '.' || at(dec_end) == 'e' ||
+                        at(dec_end) == 'E')
                     {
                         s = dec_end;
                         radix = 10;
@@ -181,7 +192,7 @@ NumericConstantParser::NumericConstantParser(Scanner &scanner,
             case 'L':
                 if (is_long || is_long_long)
                     break; // Repeated l or L suffix.
-                if (s[1] == s[0])
+                if (at(s + 1) == *s)
                 {
                     if (is_fp)
                         break; // Invalid ll or LL suffix for floating constants.
@@ -247,7 +258,8 @@ static auto integer_fits_into_64bits(int32_t num_of_digits, int32_t radix)
     }
 }
 
-auto NumericConstantParser::to_integer() const -> std::pair<uint64_t, bool>
+auto NumericConstantParser::to_integer_scalar() const
+    -> std::pair<uint64_t, bool>
 {
     cci_expects(is_integer_literal());
     cci_expects(radix == 8 || radix == 10 || radix == 16);
@@ -279,6 +291,107 @@ auto NumericConstantParser::to_integer() const -> std::pair<uint64_t, bool>
     return {value, overflowed};
 }
 
+// Loads 8 digits into a word, the first digit in the lowest byte.
+static auto load_8_digits(const char *digits) -> uint64_t
+{
+    uint64_t word;
+    std::memcpy(&word, digits, sizeof(word));
+    if constexpr (std::endian::native == std::endian::big)
+        word = __builtin_bswap64(word);
+    return word;
+}
+
+// Converts 8 decimal digits at once (SWAR). Each step merges pairs of adjacent
+// lanes, doubling their width: 8 lanes of 1 digit, 4 of 2, 2 of 4, 1 of 8.
+static auto parse_8_decimal_digits(const char *digits) -> uint64_t
+{
+    uint64_t word = load_8_digits(digits) - 0x3030303030303030;
+    word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FF;
+    word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFF;
+    return (word * 10000 + (word >> 32)) & 0x00000000FFFFFFFF;
+}
+
+// Converts 8 hexadecimal digits at once (SWAR), in the same fashion as
+// `parse_8_decimal_digits`.
+static auto parse_8_hex_digits(const char *digits) -> uint64_t
+{
+    uint64_t word = load_8_digits(digits);
+    // Letters have bit 6 set, and their low nibble is 9 less than their value.
+    const uint64_t letters = (word >> 6) & 0x0101010101010101;
+    word = (word & 0x0F0F0F0F0F0F0F0F) + letters * 9;
+    word = ((word & 0x000F000F000F000F) << 4) |
+           ((word >> 8) & 0x000F000F000F000F);
+    word = ((word & 0x000000FF000000FF) << 8) |
+           ((word >> 16) & 0x000000FF000000FF);
+    return ((word & 0x000000000000FFFF) << 16) | ((word >> 32) & 0xFFFF);
+}
+
+auto NumericConstantParser::to_integer() const -> std::pair<uint64_t, bool>
+{
+    cci_expects(is_integer_literal());
+    cci_expects(radix == 8 || radix == 10 || radix == 16);
+
+    if (radix == 8)
+        return to_integer_scalar();
+
+    // Digits are taken 8 at a time while there are that many left, and then
+    // one at a time, which amounts to the same sums and products as doing it
+    // digit by digit. Overflowing is sticky, and the value wraps around in
+    // both, so the result is the same as `to_integer_scalar`'s, overflowed
+    // or not.
+    const bool is_hex = radix == 16;
+    const uint64_t chunk_scale = is_hex ? uint64_t(1) << 32 : 100'000'000;
+    const bool fits = integer_fits_into_64bits(digit_end - digit_begin, radix);
+    uint64_t value = 0;
+    bool overflowed = false;
+    const char *it = digit_begin;
+
+    for (; digit_end - it >= 8; it += 8)
+    {
+        const uint64_t chunk =
+            is_hex ? parse_8_hex_digits(it) : parse_8_decimal_digits(it);
+        if (!fits)
+            overflowed |= value > (UINT64_MAX - chunk) / chunk_scale;
+        value = value * chunk_scale + chunk;
+    }
+
+    for (; it != digit_end; ++it)
+    {
+        const uint64_t digit = hexdigit_value(*it);
+        if (!fits)
+            overflowed |= value > (UINT64_MAX - digit) / radix;
+        value = value * radix + digit;
+    }
+
+    return {value, overflowed};
+}
+
+template <typename T>
+auto NumericConstantParser::to_floating() const -> std::pair<T, bool>
+{
+    cci_expects(is_floating_literal());
+    cci_expects(radix == 10 || radix == 16);
+    const std::string_view digits(digit_begin,
+                                  static_cast<size_t>(digit_end - digit_begin));
+    return radix == 16 ? hex_to_float<T>(digits) : decimal_to_float<T>(digits);
+}
+
+auto NumericConstantParser::to_float() const -> std::pair<float, bool>
+{
+    return to_floating<float>();
+}
+
+auto NumericConstantParser::to_double() const -> std::pair<double, bool>
+{
+    return to_floating<double>();
+}
+
+auto NumericConstantParser::to_long_double() const
+    -> std::pair<long double, bool>
+{
+    return to_floating<long double>();
+}
+
 // Reads a UCN escape value and sets it to `*code_point`. Returns true
 // on success.
 //
@@ -518,7 +631,6 @@ CharConstantParser::CharConstantParser(Scanner &scanner,
     : value(0), char_token_kind(char_token_kind)
 {
     cci_expects(is_char_constant(char_token_kind));
-    cci_expects(tok_lexeme.end()[0] == '\0');
 
     const char *const tok_begin = tok_lexeme.begin();
     const char *tok_end = tok_lexeme.end();
@@ -691,10 +803,6 @@ StringLiteralParser::StringLiteralParser(Scanner &scanner,
     cci_expects(string_toks[0].size() >= 2);
     size_t size_bound = string_toks[0].size() - 2; // removes ""
 
-    // Holds the size of the biggest string literal. This is used to allocate
-    // memory for a temporary buffer to hold the processed strings.
-    size_t max_token_size = size_bound;
-
     cci_expects(is_string_literal(string_toks[0].kind));
     token_kind = string_toks[0].kind;
 
@@ -729,7 +837,6 @@ StringLiteralParser::StringLiteralParser(Scanner &scanner,
 
         cci_expects(string_toks[i].size() >= 2);
         size_bound += string_toks[i].size() - 2; // removes ""
-        max_token_size = std::max(max_token_size, string_toks[i].size() - 2);
     }
 
     // Allows an space for the null terminator.
@@ -743,11 +850,11 @@ StringLiteralParser::StringLiteralParser(Scanner &scanner,
     // More space is needed if we have wide/unicode strings literals.
     size_bound *= char_byte_width;
 
-    // Token spellings are written to this buffer.
+    // Spellings of dirty tokens are written to this buffer, while clean ones
+    // are read in place.
     small_string<256> token_buf;
 
     this->result_buf.resize(size_bound);
-    token_buf.resize(max_token_size);
 
     // In case we get an empty string literal, there's nothing left to be done.
     if (size_bound == 0)
@@ -758,15 +865,11 @@ StringLiteralParser::StringLiteralParser(Scanner &scanner,
 
     for (const auto &string_tok : string_toks)
     {
-        // Gets the token spelling, and writes it to `token_buf`. There's no
-        // need to clear the buffer, since we know the amount of bytes that is
-        // written to the buffer, which is enough to form a range of iterators.
-        const char *tokbuf_ptr = token_buf.data();
-        const size_t tok_length = Scanner::get_spelling_to_buffer(
-            string_tok, token_buf.data(), scanner.source_map);
-
+        const std::string_view spelling =
+            scanner.get_spelling(string_tok, token_buf);
+        const char *tokbuf_ptr = spelling.data();
         const char *tokbuf_begin = tokbuf_ptr;
-        const char *tokbuf_end = tokbuf_begin + tok_length;
+        const char *tokbuf_end = tokbuf_begin + spelling.size();
 
         // Skips u, U, or L.
         if (string_tok.is_not(TokenKind::string_literal))
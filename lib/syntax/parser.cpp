@@ -16,25 +16,10 @@ namespace cci::syntax {
 
 auto Parser::peek_tok(size_t lookahead) -> Token
 {
-    cci_expects(peeked_toks.size() >= lookahead);
-
-    if (lookahead < peeked_toks.size())
-        return peeked_toks[lookahead];
-
-    Token peeking = scanner.next_token();
-    peeked_toks.push_back(peeking);
-    cci_ensures(lookahead + 1 == peeked_toks.size());
-    return peeking;
+    return cursor.peek(lookahead);
 }
 
-auto Parser::consume_tok() -> Token
-{
-    Token consumed = peek_tok();
-    std::move(std::next(peeked_toks.begin()), peeked_toks.end(),
-              peeked_toks.begin());
-    peeked_toks.pop_back();
-    return consumed;
-}
+auto Parser::consume_tok() -> Token { return cursor.consume(); }
 
 auto Parser::expect_and_consume_tok(TokenKind token_kind)
     -> std::optional<Token>
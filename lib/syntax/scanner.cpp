@@ -1,5 +1,6 @@
 #include "cci/syntax/scanner.hpp"
 #include "cci/syntax/char_info.hpp"
+#include "cci/syntax/char_scan.hpp"
 #include "cci/syntax/diagnostics.hpp"
 #include "cci/syntax/source_map.hpp"
 #include "cci/syntax/token.hpp"
@@ -13,13 +14,6 @@
 
 namespace cci::syntax {
 
-constexpr auto is_newline(char C) -> bool { return C == '\n' || C == '\r'; }
-
-constexpr auto is_whitespace(char C) -> bool
-{
-    return C == ' ' || C == '\t' || is_newline(C) || C == '\v' || C == '\f';
-}
-
 // The following few helper functions are inspired by Clang's scanner
 // implementation.
 //
@@ -346,6 +340,113 @@ auto Scanner::try_advance_identifier_utf8(const char *&cur_ptr) -> bool
     return false;
 }
 
+// Keywords are recognized by a perfect hash on the spelling's length, first
+// and last characters, which are enough to tell all C11 keywords apart. The
+// multipliers below were found by a brute-force search, and the table built
+// from them is checked at compile time to have no collisions, so a lookup is
+// a single probe followed by a string comparison.
+struct KeywordEntry
+{
+    std::string_view spelling;
+    TokenKind kind = TokenKind::identifier;
+};
+
+constexpr KeywordEntry keyword_entries[]{
+    {"auto", TokenKind::kw_auto},
+    {"break", TokenKind::kw_break},
+    {"case", TokenKind::kw_case},
+    {"char", TokenKind::kw_char},
+    {"const", TokenKind::kw_const},
+    {"continue", TokenKind::kw_continue},
+    {"default", TokenKind::kw_default},
+    {"do", TokenKind::kw_do},
+    {"double", TokenKind::kw_double},
+    {"else", TokenKind::kw_else},
+    {"enum", TokenKind::kw_enum},
+    {"extern", TokenKind::kw_extern},
+    {"float", TokenKind::kw_float},
+    {"for", TokenKind::kw_for},
+    {"goto", TokenKind::kw_goto},
+    {"if", TokenKind::kw_if},
+    {"inline", TokenKind::kw_inline},
+    {"int", TokenKind::kw_int},
+    {"long", TokenKind::kw_long},
+    {"register", TokenKind::kw_register},
+    {"restrict", TokenKind::kw_restrict},
+    {"return", TokenKind::kw_return},
+    {"short", TokenKind::kw_short},
+    {"signed", TokenKind::kw_signed},
+    {"sizeof", TokenKind::kw_sizeof},
+    {"static", TokenKind::kw_static},
+    {"struct", TokenKind::kw_struct},
+    {"switch", TokenKind::kw_switch},
+    {"typedef", TokenKind::kw_typedef},
+    {"union", TokenKind::kw_union},
+    {"unsigned", TokenKind::kw_unsigned},
+    {"void", TokenKind::kw_void},
+    {"volatile", TokenKind::kw_volatile},
+    {"while", TokenKind::kw_while},
+    {"_Alignas", TokenKind::kw__Alignas},
+    {"_Alignof", TokenKind::kw__Alignof},
+    {"_Atomic", TokenKind::kw__Atomic},
+    {"_Bool", TokenKind::kw__Bool},
+    {"_Complex", TokenKind::kw__Complex},
+    {"_Generic", TokenKind::kw__Generic},
+    {"_Imaginary", TokenKind::kw__Imaginary},
+    {"_Noreturn", TokenKind::kw__Noreturn},
+    {"_Static_assert", TokenKind::kw__Static_assert},
+    {"_Thread_local", TokenKind::kw__Thread_local},
+};
+
+constexpr size_t keyword_table_size = 128;
+constexpr size_t min_keyword_length = 2; // "do", "if"
+constexpr size_t max_keyword_length = 14; // "_Static_assert"
+
+constexpr auto keyword_hash(std::string_view spelling) -> size_t
+{
+    const auto first = static_cast<unsigned char>(spelling.front());
+    const auto last = static_cast<unsigned char>(spelling.back());
+    return (first + last * 30 + spelling.size() * 33) % keyword_table_size;
+}
+
+struct KeywordTable
+{
+    KeywordEntry slots[keyword_table_size]{};
+    bool has_collisions = false;
+};
+
+constexpr auto make_keyword_table() -> KeywordTable
+{
+    KeywordTable table;
+    for (const KeywordEntry &entry : keyword_entries)
+    {
+        KeywordEntry &slot = table.slots[keyword_hash(entry.spelling)];
+        table.has_collisions |= !slot.spelling.empty();
+        slot = entry;
+    }
+    return table;
+}
+
+constexpr KeywordTable keyword_table = make_keyword_table();
+static_assert(!keyword_table.has_collisions,
+              "keyword hash is not perfect; search for new multipliers");
+
+/// Maps an identifier's spelling to its keyword token kind.
+//
+/// \param spelling The identifier's spelling, free of trigraphs and escaped
+///                 newlines.
+///
+/// \return The keyword's token kind, or `TokenKind::identifier` if the spelling
+///         isn't a keyword.
+static auto lookup_keyword(std::string_view spelling) -> TokenKind
+{
+    if (spelling.size() < min_keyword_length ||
+        spelling.size() > max_keyword_length)
+        return TokenKind::identifier;
+    const KeywordEntry &slot = keyword_table.slots[keyword_hash(spelling)];
+    return slot.spelling == spelling ? slot.kind : TokenKind::identifier;
+}
+
 // identifier: [C11 6.4.2]
 //   identifier-nondigit
 //   identifier  identifier-nondigit
@@ -412,47 +513,20 @@ auto Scanner::lex_identifier(const char *cur_ptr, Token &result) -> bool
         }
     }
 
+    const char *const tok_begin = buffer_ptr;
     form_token(result, cur_ptr, TokenKind::identifier);
 
     // Changes the token's category to a keyword if this happens to be one.
+    // Clean identifiers are looked up straight from the source buffer, and
+    // only dirty ones have their spelling materialized first.
     if (!result.has_UCN())
     {
-        small_string<16> ident_buf;
-        const auto spelling = this->get_spelling(result, ident_buf);
-
-        static constexpr TokenKind keyword_kinds[]{
-            TokenKind::kw_auto,           TokenKind::kw_break,
-            TokenKind::kw_case,           TokenKind::kw_char,
-            TokenKind::kw_const,          TokenKind::kw_continue,
-            TokenKind::kw_default,        TokenKind::kw_do,
-            TokenKind::kw_double,         TokenKind::kw_else,
-            TokenKind::kw_enum,           TokenKind::kw_extern,
-            TokenKind::kw_float,          TokenKind::kw_for,
-            TokenKind::kw_goto,           TokenKind::kw_if,
-            TokenKind::kw_inline,         TokenKind::kw_int,
-            TokenKind::kw_long,           TokenKind::kw_register,
-            TokenKind::kw_restrict,       TokenKind::kw_return,
-            TokenKind::kw_short,          TokenKind::kw_signed,
-            TokenKind::kw_sizeof,         TokenKind::kw_static,
-            TokenKind::kw_struct,         TokenKind::kw_switch,
-            TokenKind::kw_typedef,        TokenKind::kw_union,
-            TokenKind::kw_unsigned,       TokenKind::kw_void,
-            TokenKind::kw_volatile,       TokenKind::kw_while,
-            TokenKind::kw__Alignas,       TokenKind::kw__Alignof,
-            TokenKind::kw__Atomic,        TokenKind::kw__Bool,
-            TokenKind::kw__Complex,       TokenKind::kw__Generic,
-            TokenKind::kw__Imaginary,     TokenKind::kw__Noreturn,
-            TokenKind::kw__Static_assert, TokenKind::kw__Thread_local,
-        };
-
-        // FIXME: This is far from ideal. Maybe use some trie?
-        for (const TokenKind kind : keyword_kinds)
+        if (!result.is_dirty())
+            result.kind = lookup_keyword({tok_begin, result.size()});
+        else
         {
-            if (spelling == to_string(kind))
-            {
-                result.kind = kind;
-                break;
-            }
+            small_string<16> ident_buf;
+            result.kind = lookup_keyword(this->get_spelling(result, ident_buf));
         }
     }
 
@@ -492,7 +566,7 @@ auto Scanner::lex_numeric_constant(const char *cur_ptr, Token &result) -> bool
     // binary-exponent-part:
     //    'p' sign[opt] digit-sequence
     //    'P' sign[opt] digit-sequence
-    if ((c == '+' || c == '-') ||
+    if ((c == '+' || c == '-') &&
         (prev == 'e' || prev == 'E' || prev == 'p' || prev == 'P'))
         return lex_numeric_constant(consume_char(cur_ptr, digit_size, result),
                                     result);
@@ -511,8 +585,6 @@ auto Scanner::lex_numeric_constant(const char *cur_ptr, Token &result) -> bool
 /// \return A pointer past the end of the comment, i.e. the newline.
 auto Scanner::skip_line_comment(const char *cur_ptr) -> const char *
 {
-    auto [c, c_size] = peek_char_and_size(cur_ptr);
-
     // C11 6.4.9/2: Except within a character constant, a string literal, or a
     // comment, the characters // introduce a comment that includes all
     // multibyte characters up to, but not including, the next new-line
@@ -520,6 +592,11 @@ auto Scanner::skip_line_comment(const char *cur_ptr) -> const char *
     // multibyte characters and to find the terminating new-line character.
     while (true)
     {
+        // Only newlines, the end of input, and escaped newlines need a closer
+        // look, so everything else is skipped over in blocks.
+        cur_ptr = find_line_comment_stop(cur_ptr, buffer_end);
+        const auto [c, c_size] = peek_char_and_size(cur_ptr);
+
         if (is_newline(c))
         {
             cur_ptr += c_size;
@@ -535,7 +612,6 @@ auto Scanner::skip_line_comment(const char *cur_ptr) -> const char *
         }
 
         cur_ptr += c_size;
-        std::tie(c, c_size) = peek_char_and_size(cur_ptr);
     }
 
     return cur_ptr;
@@ -550,14 +626,24 @@ auto Scanner::skip_line_comment(const char *cur_ptr) -> const char *
 /// \return A pointer past the end of the comment.
 auto Scanner::skip_block_comment(const char *cur_ptr) -> const char *
 {
-    auto [c, c_size] = peek_char_and_size(cur_ptr);
-    char prev = c;
+    // The character before `cur_ptr`, after decoding trigraphs and escaped
+    // newlines. Only whether it is a '*' matters.
+    char prev = '\0';
 
-    // Could be recursive, but that might not be a good idea.  This also could
-    // be improved upon. Right now it handles trigraphs and escaped newlines,
-    // which does the job just fine.
     while (true)
     {
+        // Characters that can't end the comment nor form an escaped newline
+        // are skipped over in blocks. These are all trivial, so the last one
+        // skipped is the previous character as is.
+        const char *const stop = find_block_comment_stop(cur_ptr, buffer_end);
+        if (stop != cur_ptr)
+        {
+            prev = stop[-1];
+            cur_ptr = stop;
+        }
+
+        const auto [c, c_size] = peek_char_and_size(cur_ptr);
+
         // C11 6.4.9/1: Except within a character constant, a string literal, or
         // a comment, the characters /* introduce a comment. The contents of
         // such a comment are examined only to identify multibyte characters and
@@ -579,7 +665,6 @@ auto Scanner::skip_block_comment(const char *cur_ptr) -> const char *
 
         cur_ptr += c_size;
         prev = c;
-        std::tie(c, c_size) = peek_char_and_size(cur_ptr);
     }
 
     return cur_ptr;
@@ -759,8 +844,10 @@ scan:
     if (cur_ptr == buffer_end)
         return false;
 
-    // Skips any whitespace before the token.
-    cur_ptr = std::find_if_not(cur_ptr, buffer_end, is_whitespace);
+    // Skips any whitespace before the token. Tokens are mostly separated by a
+    // single space, so only runs of whitespace pay for the block search.
+    if (is_whitespace(*cur_ptr))
+        cur_ptr = skip_whitespace(cur_ptr + 1, buffer_end);
     buffer_ptr = cur_ptr;
 
     auto [ch, ch_size] = peek_char_and_size(cur_ptr);
@@ -890,11 +977,15 @@ scan:
                 // should be `a / b` in C89, but is currently parsed as `a`,
                 // because of C11's line comments.
                 buffer_ptr = skip_line_comment(cur_ptr + ch_size);
+                // Escaped newlines before the comment don't make the next
+                // token dirty.
+                result = Token();
                 return lex_token(buffer_ptr, result);
             }
             else if (ch == '*')
             {
                 buffer_ptr = skip_block_comment(cur_ptr + ch_size);
+                result = Token();
                 return lex_token(buffer_ptr, result);
             }
             else if (ch == '=')
@@ -1194,8 +1285,9 @@ auto Scanner::next_token() -> Token
 auto Scanner::character_location(ByteLoc tok_loc, const char *spelling_begin,
                                  const char *char_pos) const -> ByteLoc
 {
-    const auto [file, offset] = this->source_map.lookup_byte_offset(tok_loc);
-    const char *cur_ptr = this->buffer_begin + static_cast<size_t>(offset);
+    cci_expects(tok_loc >= this->file_loc);
+    const char *cur_ptr =
+        this->file_begin + static_cast<size_t>(tok_loc - this->file_loc);
     for (auto it = spelling_begin; it != char_pos; ++it)
     {
         const auto [c, size] =
@@ -1203,13 +1295,13 @@ auto Scanner::character_location(ByteLoc tok_loc, const char *spelling_begin,
         cci_expects(c == *it);
         cur_ptr += size;
     }
-    return this->source_map.ptr_to_byteloc(this->file_loc, cur_ptr);
+    return location_for_ptr(cur_ptr);
 }
 
 auto Scanner::get_spelling_to_buffer(const Token &tok, char *spelling_buf,
                                      const SourceMap &map) -> size_t
 {
-    std::string_view spelling = map.span_to_snippet(tok.source_span);
+    std::string_view spelling = map.span_to_snippet(tok.source_span());
     const auto spell_start = spelling.begin();
     const auto spell_end = spelling.end();
 
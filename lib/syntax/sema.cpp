@@ -10,6 +10,7 @@
 #include "cci/util/small_vector.hpp"
 #include <memory>
 #include <string_view>
+#include <tuple>
 
 static_assert(sizeof(std::uint16_t) == sizeof(char16_t),
               "UTF-16 string literals assume that char16_t is 2 bytes long");
@@ -24,6 +25,7 @@ using cci::ast::CharacterConstantKind;
 using cci::ast::ConstantArrayType;
 using cci::ast::Expr;
 using cci::ast::ExprValueKind;
+using cci::ast::FloatingLiteral;
 using cci::ast::ImplicitCastExpr;
 using cci::ast::IntegerLiteral;
 using cci::ast::ParenExpr;
@@ -40,17 +42,15 @@ auto Sema::act_on_numeric_constant(const Token &tok)
 {
     cci_expects(tok.is(TokenKind::numeric_constant));
 
-    if (tok.size() == 1)
+    small_string<64> spell_buffer;
+    std::string_view spelling = scanner.get_spelling(tok, spell_buffer);
+
+    if (spelling.size() == 1)
     {
-        const char digit =
-            scanner.source_map.span_to_snippet(tok.source_span)[0];
-        return IntegerLiteral::create(context, digit - '0', context.int_ty,
-                                      tok.source_span);
+        return IntegerLiteral::create(context, spelling[0] - '0',
+                                      context.int_ty, tok.source_span());
     }
 
-    small_string<64> spell_buffer;
-    std::string_view spelling = scanner.get_spelling(tok, spell_buffer);
-    spell_buffer.push_back('\0');
     NumericConstantParser literal(scanner, spelling, tok.location());
 
     if (literal.has_error)
@@ -136,11 +136,42 @@ auto Sema::act_on_numeric_constant(const Token &tok)
         val &= -1U >> (64 - width);
 
         return IntegerLiteral::create(context, val, integer_ty,
-                                      tok.source_span);
+                                      tok.source_span());
     }
     else if (literal.is_floating_literal())
     {
-        cci_unreachable(); // TODO: Implement me!
+        // [C11 6.4.4.2p4]: An unsuffixed floating constant has type double.
+        // If suffixed by the letter f or F, it has type float. If suffixed by
+        // the letter l or L, it has type long double.
+        // FIXME: The host's floating types are assumed to be the target's.
+        QualType float_ty = context.double_ty;
+        long double val = 0;
+        bool overflowed = false;
+
+        if (literal.is_float)
+        {
+            std::tie(val, overflowed) = literal.to_float();
+            float_ty = context.float_ty;
+        }
+        else if (literal.is_long)
+        {
+            std::tie(val, overflowed) = literal.to_long_double();
+            float_ty = context.long_double_ty;
+        }
+        else
+            std::tie(val, overflowed) = literal.to_double();
+
+        // [C11 6.4.4p2]: The value of a constant shall be in the range of
+        // representable values for its type. Values too small for the type
+        // are fine, though, they just round to zero or a subnormal number.
+        if (overflowed)
+        {
+            diag_handler.report(tok.location(),
+                                diag::Diag::float_literal_overflow);
+        }
+
+        return FloatingLiteral::create(context, val, float_ty,
+                                       tok.source_span());
     }
 
     return nullptr;
@@ -155,7 +186,6 @@ auto Sema::act_on_char_constant(const Token &tok)
 
     small_string<8> spell_buffer;
     std::string_view spelling = scanner.get_spelling(tok, spell_buffer);
-    spell_buffer.push_back('\0');
     CharConstantParser literal(scanner, spelling, tok.location(), tok.kind,
                                context.target_info);
 
@@ -185,7 +215,7 @@ auto Sema::act_on_char_constant(const Token &tok)
     }
 
     return CharacterConstant::create(context, literal.value, char_kind,
-                                     char_type, tok.source_span);
+                                     char_type, tok.source_span());
 }
 
 auto Sema::act_on_string_literal(span<const Token> string_toks)
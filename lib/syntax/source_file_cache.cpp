@@ -0,0 +1,144 @@
+#include "cci/syntax/source_file_cache.hpp"
+#include "cci/util/file_stream.hpp"
+#include <functional>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace cci::syntax {
+
+auto SourceFileCache::cache_key(const fs::path &file_path) -> std::string
+{
+    std::error_code ec;
+    const fs::path absolute_path = fs::absolute(file_path, ec);
+    return ec ? file_path.string() : absolute_path.lexically_normal().string();
+}
+
+auto SourceFileCache::file_stamp(const fs::path &file_path)
+    -> std::optional<FileStamp>
+{
+    std::error_code ec;
+    FileStamp stamp;
+    stamp.size = fs::file_size(file_path, ec);
+    if (ec)
+        return std::nullopt;
+    stamp.mtime = fs::last_write_time(file_path, ec);
+    if (ec)
+        return std::nullopt;
+    return stamp;
+}
+
+auto SourceFileCache::find(const std::string &key,
+                           const FileStamp &stamp) const
+    -> std::shared_ptr<const SourceFile>
+{
+    std::lock_guard lock(this->mutex);
+    const auto it = this->entries.find(key);
+    if (it == this->entries.end() || it->second.stamp != stamp)
+        return nullptr;
+    return it->second.file;
+}
+
+auto SourceFileCache::insert(std::string key, FileStamp stamp,
+                             std::shared_ptr<const SourceFile> file)
+    -> std::shared_ptr<const SourceFile>
+{
+    const size_t content_hash =
+        this->compare_contents
+            ? std::hash<std::string_view>()(file->src_view())
+            : 0;
+
+    std::lock_guard lock(this->mutex);
+    auto [it, inserted] = this->entries.try_emplace(std::move(key));
+    Entry &entry = it->second;
+
+    // Another thread may have loaded the same file in the meantime.
+    if (!inserted && entry.stamp == stamp)
+        return entry.file;
+
+    if (!inserted && this->compare_contents &&
+        entry.content_hash == content_hash &&
+        entry.file->src_view() == file->src_view())
+    {
+        entry.stamp = stamp;
+        return entry.file;
+    }
+
+    entry = Entry{stamp, content_hash, std::move(file)};
+    return entry.file;
+}
+
+auto SourceFileCache::load(const fs::path &file_path)
+    -> std::shared_ptr<const SourceFile>
+{
+    // The stamp is taken before reading the file, so a file that changes in
+    // the meantime is read again the next time it's loaded.
+    std::string key = cache_key(file_path);
+    const auto stamp = file_stamp(file_path);
+    if (!stamp)
+        return nullptr;
+
+    if (auto file = find(key, *stamp))
+        return file;
+
+    auto src = read_stream_utf8(file_path);
+    if (!src)
+        return nullptr;
+    return insert(std::move(key), *stamp,
+                  std::make_shared<const SourceFile>(file_path.string(),
+                                                     std::move(*src)));
+}
+
+auto SourceFileCache::load_all(span<const fs::path> file_paths,
+                               BatchReadBackend backend)
+    -> std::vector<std::shared_ptr<const SourceFile>>
+{
+    const auto num_files = static_cast<size_t>(file_paths.size());
+    std::vector<std::shared_ptr<const SourceFile>> files(num_files);
+    std::vector<std::string> keys(num_files);
+    std::vector<std::optional<FileStamp>> stamps(num_files);
+
+    // Only the files that aren't cached, or that changed, are read.
+    std::vector<fs::path> missing_paths;
+    std::vector<size_t> missing_idxs;
+
+    for (size_t i = 0; i < num_files; ++i)
+    {
+        keys[i] = cache_key(file_paths[i]);
+        stamps[i] = file_stamp(file_paths[i]);
+        if (!stamps[i])
+            continue;
+        files[i] = find(keys[i], *stamps[i]);
+        if (!files[i])
+        {
+            missing_paths.push_back(file_paths[i]);
+            missing_idxs.push_back(i);
+        }
+    }
+
+    const auto on_read = [&](size_t idx, std::optional<std::string> src) {
+        if (!src)
+            return;
+        const size_t i = missing_idxs[idx];
+        files[i] = insert(std::move(keys[i]), *stamps[i],
+                          std::make_shared<const SourceFile>(
+                              file_paths[i].string(), std::move(*src)));
+    };
+    read_streams_utf8(missing_paths, on_read, backend);
+
+    return files;
+}
+
+auto SourceFileCache::size() const -> size_t
+{
+    std::lock_guard lock(this->mutex);
+    return this->entries.size();
+}
+
+void SourceFileCache::clear()
+{
+    std::lock_guard lock(this->mutex);
+    this->entries.clear();
+}
+
+} // namespace cci::syntax
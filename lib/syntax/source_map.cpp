@@ -1,93 +1,376 @@
 #include "cci/syntax/source_map.hpp"
 #include "cci/syntax/char_info.hpp"
+#include "cci/syntax/char_scan.hpp"
 #include "cci/util/contracts.hpp"
+#include "cci/util/file_stream.hpp"
 #include "cci/util/unicode.hpp"
 #include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <numeric>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <system_error>
 
 namespace cci::syntax {
 
-FileMap::FileMap(std::string n, std::string s, ByteLoc sl)
-    : name(std::move(n)), src(std::move(s)), start_loc(sl)
+/// Returns the size of the UTF-8 byte order mark at the start of `src`, if
+/// there's one.
+static auto bom_size(std::string_view src) -> size_t
 {
     const auto utf8_bom = "\uFEFF";
-    if (this->src_view().substr(0, 3) == utf8_bom)
-        this->src.erase(0, 3);
+    return src.substr(0, 3) == utf8_bom ? 3 : 0;
+}
+
+SourceFile::SourceFile(std::string n, std::string s)
+    : owned_src(std::move(s)), name(std::move(n))
+{
+    if (this->owned_src.size() > bom_size(this->owned_src) &&
+        this->owned_src.back() != '\n')
+        this->owned_src.push_back('\n');
 
-    if (!this->src.empty() && this->src.back() != '\n')
-        this->src.push_back('\n');
+    init_src(this->owned_src);
+}
 
-    this->end_loc = this->start_loc + ByteLoc(this->src.size());
+SourceFile::SourceFile(std::string n, MappedFile s)
+    : mapped_src(std::move(s)), name(std::move(n))
+{
+    // The padding past the end of the mapping has room for the newline, and
+    // is zeroed, so the null character is already there after it.
+    const std::string_view contents = this->mapped_src.view();
+    if (contents.size() > bom_size(contents) && contents.back() != '\n')
+        this->mapped_src.append('\n');
+
+    init_src(this->mapped_src.view());
+}
 
-    // Computes the new line and multibyte locations of this source.
-    this->lines.push_back(this->start_loc);
+void SourceFile::init_src(std::string_view buffer)
+{
+    // The byte order mark is skipped rather than erased, which would copy the
+    // whole source.
+    this->src = buffer.substr(bom_size(buffer));
+    cci_ensures(*this->src_end() == '\0');
+}
 
-    auto it = src_view().begin();
-    while (it != src_view().end())
+auto SourceFile::source_index() const -> const SourceIndex &
+{
+    SourceIndex &idx = this->index;
+    if (!idx.is_built.load(std::memory_order_acquire))
     {
-        const char ch = *it;
-        const ByteLoc cur_loc =
-            this->start_loc + ByteLoc(it - src_view().begin());
-        cci_expects(this->contains(cur_loc));
-        if (is_ascii(ch))
+        std::call_once(idx.built, [&] {
+            build_index(idx);
+            idx.is_built.store(true, std::memory_order_release);
+        });
+    }
+    return idx;
+}
+
+void SourceFile::build_index(SourceIndex &idx) const
+{
+    // Computes the new line and multibyte locations of this source. Both
+    // tables are sized up front from a quick count of the bytes of interest.
+    const char *const begin = this->src_begin();
+    const char *const end = this->src_end();
+    const ByteCounts counts = count_newlines_and_non_ascii(begin, end);
+
+    idx.lines.reserve(counts.newlines + 1);
+    idx.lines.push_back(ByteLoc(0));
+
+    const auto loc_for_ptr = [&](const char *ptr) {
+        return ByteLoc(ptr - begin);
+    };
+
+    // Source is classified a chunk at a time, and only the bytes of interest
+    // are visited by walking the set bits of the chunk's masks. The tail that
+    // doesn't fill a whole chunk is classified one byte at a time.
+    const auto chunk_masks = [&](const char *chunk) {
+        if (end - chunk >= static_cast<ptrdiff_t>(line_chunk_size))
+            return classify_line_chunk(chunk);
+        LineChunkMasks masks;
+        for (size_t i = 0; chunk + i != end; ++i)
         {
-            if (ch == '\n')
-                this->lines.push_back(cur_loc + ByteLoc(1));
-            ++it;
+            masks.newlines |= uint64_t(chunk[i] == '\n') << i;
+            masks.non_ascii |= uint64_t(!is_ascii(chunk[i])) << i;
         }
-        else
+        return masks;
+    };
+
+    if (counts.non_ascii == 0)
+    {
+        // Plain ASCII sources have no multibyte characters to keep track of.
+        for (const char *chunk = begin; chunk < end; chunk += line_chunk_size)
         {
-            const size_t bytes =
-                uni::num_bytes_for_utf8(static_cast<uni::UTF8>(ch));
-            this->multibyte_chars.emplace_back(cur_loc, bytes);
-            it += bytes;
+            for (uint64_t nls = chunk_masks(chunk).newlines; nls != 0;
+                 nls &= nls - 1)
+            {
+                const char *nl = chunk + std::countr_zero(nls);
+                idx.lines.push_back(loc_for_ptr(nl + 1));
+            }
+        }
+    }
+    else
+    {
+        // Multibyte characters take at least two bytes each, unless they're
+        // malformed.
+        idx.multibyte_chars.reserve(counts.non_ascii / 2);
+        idx.multibyte_extra_bytes.reserve(counts.non_ascii / 2);
+
+        size_t extra_bytes = 0;
+        const char *mbc_end = begin; // Bytes before this are already taken by
+                                     // a multibyte character.
+        for (const char *chunk = begin; chunk < end; chunk += line_chunk_size)
+        {
+            const LineChunkMasks masks = chunk_masks(chunk);
+            for (uint64_t bits = masks.newlines | masks.non_ascii; bits != 0;
+                 bits &= bits - 1)
+            {
+                const char *it = chunk + std::countr_zero(bits);
+                if (it < mbc_end)
+                    continue;
+                if (*it == '\n')
+                {
+                    idx.lines.push_back(loc_for_ptr(it + 1));
+                    continue;
+                }
+
+                // Malformed UTF-8 may claim more bytes than there are left.
+                const size_t bytes = std::min(
+                    uni::num_bytes_for_utf8(static_cast<uni::UTF8>(*it)),
+                    static_cast<size_t>(end - it));
+                extra_bytes += bytes - 1;
+                idx.multibyte_chars.emplace_back(loc_for_ptr(it), bytes);
+                idx.multibyte_extra_bytes.push_back(extra_bytes);
+                mbc_end = it + bytes;
+            }
         }
     }
 
-    cci_ensures(src_view().end() == it);
-    cci_ensures(this->end_loc ==
-                (this->start_loc + ByteLoc(it - src_view().begin())));
+    cci_ensures(idx.lines.size() <= counts.newlines + 1);
+    cci_ensures(idx.lines.back() <= ByteLoc(this->size()));
 }
 
-auto FileMap::get_line(size_t line_index) const -> std::string_view
+auto SourceFile::get_line(size_t line_index) const -> std::string_view
 {
-    cci_expects(line_index < this->lines.size());
-    const ByteLoc line_loc = this->lines[line_index] - this->start_loc;
-    const ByteLoc line_end = line_index == (this->lines.size() - 1)
-                                 ? this->end_loc
-                                 : this->lines[line_index + 1];
-    const auto count = static_cast<size_t>(line_end - line_loc);
-    return this->src_view().substr(static_cast<size_t>(line_loc), count);
+    const auto &lines = this->lines();
+    cci_expects(line_index < lines.size());
+    const ByteLoc line_start = lines[line_index];
+    const ByteLoc line_end = line_index == (lines.size() - 1)
+                                 ? ByteLoc(this->size())
+                                 : lines[line_index + 1];
+    const auto count = static_cast<size_t>(line_end - line_start);
+    return this->src_view().substr(static_cast<size_t>(line_start), count);
 }
 
-auto FileMap::lookup_line_idx(ByteLoc loc) const -> size_t
+auto SourceFile::lookup_line_idx(ByteLoc offset) const -> size_t
 {
-    cci_expects(this->contains(loc));
-    auto line = std::upper_bound(this->lines.begin(), this->lines.end(), loc);
-    cci_ensures(line != this->lines.begin());
-    return static_cast<size_t>(std::prev(line) - this->lines.begin());
+    cci_expects(offset <= ByteLoc(this->size()));
+    const auto &lines = this->lines();
+    auto line = std::upper_bound(lines.begin(), lines.end(), offset);
+    cci_ensures(line != lines.begin());
+    return static_cast<size_t>(std::prev(line) - lines.begin());
 }
 
-auto SourceMap::create_owned_filemap(std::string name, std::string src)
+auto SourceFile::offset_to_charpos(ByteLoc offset) const -> CharPos
+{
+    cci_expects(offset <= ByteLoc(this->size()));
+    const SourceIndex &idx = this->source_index();
+
+    // Finds how many multibyte characters start before `offset`.
+    const auto mbc_end = std::lower_bound(
+        idx.multibyte_chars.begin(), idx.multibyte_chars.end(), offset,
+        [](const auto &mbc, ByteLoc o) { return mbc.first < o; });
+    const auto num_mbcs =
+        static_cast<size_t>(mbc_end - idx.multibyte_chars.begin());
+    if (num_mbcs == 0)
+        return CharPos(offset);
+
+    [[maybe_unused]] const auto &[last_offset, last_bytes] =
+        idx.multibyte_chars[num_mbcs - 1];
+    cci_expects(offset >= last_offset + ByteLoc(last_bytes));
+
+    const size_t extra_bytes = idx.multibyte_extra_bytes[num_mbcs - 1];
+    cci_ensures(ByteLoc(extra_bytes) <= offset);
+    return CharPos(offset - ByteLoc(extra_bytes));
+}
+
+FileMap::FileMap(std::shared_ptr<const SourceFile> f, ByteLoc sl)
+    : file(std::move(f))
+    , name(this->file->name)
+    , start_loc(sl)
+    , end_loc(sl + ByteLoc(this->file->size()))
+{}
+
+auto SourceMap::add_filemap(std::shared_ptr<const SourceFile> file)
     -> const FileMap &
 {
-    auto fm = std::make_unique<FileMap>(std::move(name), std::move(src),
-                                        next_start_loc());
+    cci_expects(file != nullptr);
+
+    // All locations must fit in a `ByteLoc`, see `SourceLocInt`.
+    const ByteLoc start_loc = next_start_loc();
+    cci_expects(file->size() <=
+                static_cast<size_t>(std::numeric_limits<SourceLocInt>::max() -
+                                    static_cast<SourceLocInt>(start_loc)));
+
+    auto fm = std::make_unique<FileMap>(std::move(file), start_loc);
+    this->start_locs.push_back(fm->start_loc);
     return *this->file_maps.emplace_back(std::move(fm));
 }
 
+auto SourceMap::create_owned_filemap(std::string name, std::string src)
+    -> const FileMap &
+{
+    return add_filemap(
+        std::make_shared<const SourceFile>(std::move(name), std::move(src)));
+}
+
+/// Returns the source of `file` after applying `edit` to it.
+static auto apply_edit(const FileMap &file, const SourceEdit &edit)
+    -> std::string
+{
+    const std::string_view src = file.src_view();
+    cci_expects(edit.offset <= src.size());
+    cci_expects(edit.removed_size <= src.size() - edit.offset);
+
+    std::string edited;
+    edited.reserve(static_cast<size_t>(
+        static_cast<std::ptrdiff_t>(src.size()) + edit.size_delta()));
+    edited.append(src.substr(0, edit.offset));
+    edited.append(edit.replacement);
+    edited.append(src.substr(edit.offset + edit.removed_size));
+    return edited;
+}
+
+auto SourceMap::create_edited_filemap(const FileMap &file,
+                                      const SourceEdit &edit)
+    -> const FileMap &
+{
+    return create_owned_filemap(std::string(file.name),
+                                apply_edit(file, edit));
+}
+
+auto SourceMap::update_filemap(const FileMap &file, const SourceEdit &edit)
+    -> const FileMap &
+{
+    cci_expects(file.file != nullptr);
+    auto edited = std::make_shared<const SourceFile>(std::string(file.name),
+                                                     apply_edit(file, edit));
+
+    // Only the last file map can grow without running into the next one.
+    const size_t idx = lookup_filemap_idx(file.start_loc);
+    cci_expects(this->file_maps[idx].get() == &file);
+    if (idx + 1 != this->file_maps.size())
+    {
+        const FileMap &moved = add_filemap(std::move(edited));
+        this->file_maps[idx]->file.reset();
+        return moved;
+    }
+
+    FileMap &last = *this->file_maps[idx];
+    cci_expects(edited->size() <=
+                static_cast<size_t>(std::numeric_limits<SourceLocInt>::max() -
+                                    static_cast<SourceLocInt>(last.start_loc)));
+    last.file = std::move(edited);
+    last.name = last.file->name;
+    last.end_loc = last.start_loc + ByteLoc(last.file->size());
+    return last;
+}
+
+auto SourceMap::create_mapped_filemap(std::string name, MappedFile src)
+    -> const FileMap &
+{
+    return add_filemap(
+        std::make_shared<const SourceFile>(std::move(name), std::move(src)));
+}
+
+auto SourceMap::load_filemap(const fs::path &file_path) -> const FileMap *
+{
+    std::error_code ec;
+    const auto file_size = fs::file_size(file_path, ec);
+    if (!ec && file_size >= min_mapped_size)
+    {
+        if (auto mapped = MappedFile::open(file_path))
+            return &create_mapped_filemap(file_path.string(),
+                                          std::move(*mapped));
+    }
+    if (auto src = read_stream_utf8(file_path))
+        return &create_owned_filemap(file_path.string(), std::move(*src));
+    return nullptr;
+}
+
+auto SourceMap::load_filemaps(span<const fs::path> file_paths,
+                              BatchReadBackend backend)
+    -> std::vector<const FileMap *>
+{
+    const auto num_files = static_cast<size_t>(file_paths.size());
+    std::vector<const FileMap *> filemaps(num_files);
+    std::vector<std::optional<std::string>> sources(num_files);
+    std::vector<bool> is_read(num_files);
+    size_t num_read = 0;
+    size_t next_filemap = 0;
+
+    const auto on_read = [&](size_t idx, std::optional<std::string> src) {
+        sources[idx] = std::move(src);
+        is_read[idx] = true;
+        ++num_read;
+
+        // Start locations are handed out in order, so file maps can only be
+        // created once all the ones before them are.
+        for (; next_filemap < num_files && is_read[next_filemap];
+             ++next_filemap)
+        {
+            auto &source = sources[next_filemap];
+            if (!source)
+                continue;
+            const FileMap &fm = create_owned_filemap(
+                file_paths[next_filemap].string(), std::move(*source));
+            source.reset();
+            if (num_read < num_files)
+                fm.source_file().lines();
+            filemaps[next_filemap] = &fm;
+        }
+    };
+
+    read_streams_utf8(file_paths, on_read, backend);
+    cci_ensures(next_filemap == num_files);
+    return filemaps;
+}
+
 auto SourceMap::lookup_filemap_idx(ByteLoc loc) const -> size_t
 {
     cci_expects(!this->file_maps.empty());
-    cci_expects(loc < this->file_maps.back()->end_loc);
-    const auto file =
-        std::find_if(this->file_maps.begin(), this->file_maps.end(),
-                     [&](const auto &fm) { return fm->contains(loc); });
-    cci_ensures(file != this->file_maps.end());
-    return static_cast<size_t>(file - this->file_maps.begin());
+    cci_expects(loc <= this->file_maps.back()->end_loc);
+
+    // Every file map ends right before the next one starts, so whether `loc`
+    // is in a file map can be told from the start locations alone, without
+    // touching the file map itself.
+    const auto in_filemap = [&](size_t idx) {
+        return this->start_locs[idx] <= loc &&
+               (idx + 1 == this->start_locs.size() ||
+                loc < this->start_locs[idx + 1]);
+    };
+
+    // The cache may be stale if another thread raced with us, but it's always
+    // a valid index, so checking it is enough to trust it.
+    const size_t last_idx =
+        this->last_filemap_idx.load(std::memory_order_relaxed);
+    if (last_idx < this->start_locs.size() && in_filemap(last_idx))
+        return last_idx;
+
+    // File maps are laid out in order, so the one containing `loc` is the
+    // last one starting at or before it.
+    const auto start = std::upper_bound(this->start_locs.begin(),
+                                        this->start_locs.end(), loc);
+    cci_ensures(start != this->start_locs.begin());
+    const auto idx =
+        static_cast<size_t>(std::prev(start) - this->start_locs.begin());
+    cci_ensures(this->file_maps[idx]->contains(loc));
+
+    this->last_filemap_idx.store(idx, std::memory_order_relaxed);
+    return idx;
 }
 
 auto SourceMap::lookup_filemap(ByteLoc loc) const -> const FileMap &
@@ -99,6 +382,9 @@ auto SourceMap::next_start_loc() const -> ByteLoc
 {
     // Adding 1 to the next starting location facilitates the distinction
     // between empty file maps.
+    cci_expects(this->file_maps.empty() ||
+                this->file_maps.back()->end_loc !=
+                    ByteLoc(std::numeric_limits<SourceLocInt>::max()));
     return this->file_maps.empty()
                ? ByteLoc(0)
                : this->file_maps.back()->end_loc + ByteLoc(1);
@@ -123,9 +409,8 @@ auto SourceMap::lookup_source_location(ByteLoc loc) const -> SourceLoc
 {
     const auto [fm, chloc] = byteloc_to_filemap_charloc(loc);
     const auto line_idx = fm.lookup_line_idx(loc);
-    // FIXME: Refinding the file map is unnecessary; make it a FileMap operation.
-    const auto line_chloc =
-        byteloc_to_filemap_charloc(fm.lines[line_idx]).second;
+    const auto line_chloc = fm.byteloc_to_charpos(
+        fm.start_loc + fm.source_file().lines()[line_idx]);
 
     const auto line = LineNum(line_idx + 1);
     const auto col = chloc - line_chloc;
@@ -139,6 +424,84 @@ auto SourceMap::lookup_source_location(ByteLoc loc) const -> SourceLoc
     };
 }
 
+auto SourceMap::lookup_source_locations(span<const ByteLoc> locs) const
+    -> std::vector<SourceLoc>
+{
+    // Resolves the locations in increasing order, so that the searches in the
+    // tables below can resume from where the previous location was found.
+    std::vector<size_t> order(locs.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    if (!std::is_sorted(locs.begin(), locs.end()))
+    {
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return locs[a] < locs[b];
+        });
+    }
+
+    struct Resolved
+    {
+        const FileMap *file = nullptr;
+        LineNum line = LineNum(0);
+        CharPos column = CharPos(0);
+    };
+    std::vector<Resolved> resolved(locs.size());
+
+    for (size_t i = 0; i < order.size();)
+    {
+        const FileMap &fm = lookup_filemap(locs[order[i]]);
+        const SourceFile &file = fm.source_file();
+        const auto &lines = file.lines();
+        const auto &mbcs = file.multibyte_chars();
+        const auto &extra_bytes = file.multibyte_extra_bytes();
+
+        // Returns the character position of `offset`, searching for its
+        // multibyte characters from `it` on.
+        const auto to_charpos = [&](ByteLoc offset, auto &it) {
+            it = std::lower_bound(
+                it, mbcs.end(), offset,
+                [](const auto &mbc, ByteLoc o) { return mbc.first < o; });
+            const auto num_mbcs = static_cast<size_t>(it - mbcs.begin());
+            return num_mbcs == 0
+                       ? CharPos(offset)
+                       : CharPos(offset - ByteLoc(extra_bytes[num_mbcs - 1]));
+        };
+
+        auto line_it = lines.begin();
+        auto mbc_it = mbcs.begin();
+        auto line_mbc_it = mbcs.begin();
+        for (; i < order.size() && fm.contains(locs[order[i]]); ++i)
+        {
+            const ByteLoc offset = locs[order[i]] - fm.start_loc;
+            line_it = std::upper_bound(line_it, lines.end(), offset);
+            cci_expects(line_it != lines.begin());
+
+            const auto line_idx =
+                static_cast<size_t>(std::prev(line_it) - lines.begin());
+            const CharPos line_chloc = to_charpos(lines[line_idx], line_mbc_it);
+            const CharPos chloc = to_charpos(offset, mbc_it);
+            cci_expects(chloc >= line_chloc);
+
+            resolved[order[i]] = Resolved{
+                .file = &fm,
+                .line = LineNum(line_idx + 1),
+                .column = chloc - line_chloc,
+            };
+        }
+    }
+
+    std::vector<SourceLoc> source_locs;
+    source_locs.reserve(resolved.size());
+    for (const Resolved &r : resolved)
+    {
+        source_locs.push_back(SourceLoc{
+            .file = *r.file,
+            .line = r.line,
+            .column = r.column,
+        });
+    }
+    return source_locs;
+}
+
 auto SourceMap::span_to_snippet(ByteSpan range) const -> std::string_view
 {
     cci_expects(range.start <= range.end);
@@ -157,21 +520,6 @@ auto SourceMap::byteloc_to_filemap_charloc(ByteLoc loc) const
     -> std::pair<const FileMap &, CharPos>
 {
     const FileMap &filemap = *this->file_maps[lookup_filemap_idx(loc)];
-    size_t extra_bytes = 0;
-
-    for (const auto &[mbc_loc, mbc_bytes] : filemap.multibyte_chars)
-    {
-        if (mbc_loc < loc)
-        {
-            // Count only the extra bytes.
-            extra_bytes += mbc_bytes - 1;
-            cci_expects(loc >= mbc_loc + ByteLoc(mbc_bytes));
-        }
-        else
-            break;
-    }
-
-    cci_ensures(filemap.start_loc + ByteLoc(extra_bytes) <= loc);
-    return {filemap, CharPos(loc - filemap.start_loc - ByteLoc(extra_bytes))};
+    return {filemap, filemap.byteloc_to_charpos(loc)};
 }
 } // namespace cci::syntax
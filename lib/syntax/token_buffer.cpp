@@ -0,0 +1,389 @@
+#include "cci/syntax/token_buffer.hpp"
+#include "cci/syntax/char_info.hpp"
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <thread>
+
+namespace cci::syntax {
+
+auto TokenBuffer::lex(const FileMap &file, diag::Handler &diag) -> TokenBuffer
+{
+    Scanner scanner(file, diag);
+    TokenBuffer tokens = lex_remaining(scanner);
+    return tokens;
+}
+
+auto TokenBuffer::lex_remaining(Scanner &scanner) -> TokenBuffer
+{
+    TokenBuffer tokens(scanner.file_start_loc());
+
+    // C code averages a token every few bytes, so this avoids most of the
+    // reallocations without overcommitting much.
+    tokens.reserve(scanner.remaining_size() / 4);
+
+    for (Token tok = scanner.next_token(); tok.is_not(TokenKind::eof);
+         tok = scanner.next_token())
+        tokens.push_back(tok);
+
+    return tokens;
+}
+
+namespace {
+
+/// A chunk of a file map lexed speculatively by `lex_chunk`.
+struct Chunk
+{
+    const char *begin; ///< Where lexing of the chunk starts.
+    const char *limit; ///< Tokens starting at or past this belong to the next
+                       ///< chunk.
+
+    TokenBuffer tokens;
+
+    /// Offset of the first token starting at or past `limit`, or the size of
+    /// the file if there's none.
+    size_t resume = 0;
+
+    /// Index of the first token from which on no diagnostics were reported.
+    /// Tokens before it can't be trusted, as their diagnostics were dropped.
+    size_t clean_from = std::numeric_limits<size_t>::max();
+
+    Chunk(ByteLoc file_loc, const char *begin, const char *limit)
+        : begin(begin), limit(limit), tokens(file_loc)
+    {}
+};
+
+} // namespace
+
+/// Returns the offset of `tok` into `file`. The end-of-input token has no
+/// location, so it's considered to start at the end of the file.
+static auto token_offset(const FileMap &file, const Token &tok) -> size_t
+{
+    if (tok.is(TokenKind::eof))
+        return file.src_view().size();
+    return static_cast<size_t>(tok.location() - file.start_loc);
+}
+
+/// Checks whether the newline at `nl` is preceded by a backslash, i.e. whether
+/// it's an escaped newline, and thus doesn't start a new line at all.
+static auto is_escaped_newline(const char *begin, const char *nl) -> bool
+{
+    const char *prev = nl;
+    if (prev != begin && prev[-1] == '\r')
+        --prev;
+    if (prev != begin && prev[-1] == '\\')
+        return true;
+    return prev - begin >= 3 && std::memcmp(prev - 3, "\?\?/", 3) == 0;
+}
+
+/// Returns the offset of the last line break before `offset`, or zero if
+/// there is none. A line break here is a newline character that no escaped
+/// newline could be part of, i.e. one that isn't preceded by a backslash, a
+/// trigraph, or another newline character.
+//
+/// The scanner never looks past such a line break while lexing a token, as
+/// it only continues peeking through escaped newlines.
+static auto find_line_break_before(const char *begin, size_t offset) -> size_t
+{
+    for (size_t pos = offset; pos-- > 0;)
+    {
+        if (!is_newline(begin[pos]))
+            continue;
+        if (pos == 0)
+            return 0;
+        const char prev = begin[pos - 1];
+        if (!is_newline(prev) && prev != '\\' &&
+            !(pos >= 3 && std::memcmp(begin + pos - 3, "\?\?/", 3) == 0))
+            return pos;
+    }
+    return 0;
+}
+
+/// Guesses the start of a line at or after `ptr` that is a safe place to
+/// start lexing from, that is, one that isn't inside of a comment or literal.
+//
+/// This is only a heuristic: escaped newlines are skipped, and so are lines
+/// starting with '*', as that is how most lines in a block comment look.
+/// Wrong guesses are caught when the chunks are stitched together.
+///
+/// \return The start of the line, or `end` if there is none.
+static auto find_chunk_boundary(const char *begin, const char *ptr,
+                                const char *end) -> const char *
+{
+    while (ptr != end)
+    {
+        const char *nl = static_cast<const char *>(
+            std::memchr(ptr, '\n', static_cast<size_t>(end - ptr)));
+        if (!nl)
+            return end;
+        ptr = nl + 1;
+        if (is_escaped_newline(begin, nl))
+            continue;
+        const char *first = ptr;
+        while (first != end && (*first == ' ' || *first == '\t'))
+            ++first;
+        if (first != end && *first != '*')
+            return ptr;
+    }
+    return end;
+}
+
+/// Lexes the tokens of `chunk` that start before its limit. Diagnostics are
+/// not reported, but counted so that the tokens they came from can be lexed
+/// again. This runs on a worker thread, so any contract violation makes the
+/// whole chunk untrusted instead of escaping the thread.
+static void lex_chunk(const FileMap &file, const SourceMap &map,
+                      Chunk &chunk) noexcept
+{
+    diag::Handler local_diag(diag::ignoring_emitter(), map);
+    try
+    {
+        Scanner scanner(file.start_loc, chunk.begin, file.src_end(),
+                        local_diag);
+        const auto limit = static_cast<size_t>(chunk.limit - file.src_begin());
+        size_t err_count = 0;
+        chunk.clean_from = 0;
+        chunk.tokens.reserve(static_cast<size_t>(chunk.limit - chunk.begin) /
+                             4);
+
+        Token tok = scanner.next_token();
+        while (token_offset(file, tok) < limit)
+        {
+            if (local_diag.err_count() != err_count)
+            {
+                err_count = local_diag.err_count();
+                chunk.clean_from = chunk.tokens.size() + 1;
+            }
+            chunk.tokens.push_back(tok);
+            tok = scanner.next_token();
+        }
+
+        chunk.resume = token_offset(file, tok);
+        if (local_diag.err_count() != err_count)
+            chunk.clean_from = std::numeric_limits<size_t>::max();
+    }
+    catch (...)
+    {
+        chunk.clean_from = std::numeric_limits<size_t>::max();
+    }
+}
+
+auto TokenBuffer::lex_parallel(const FileMap &file, diag::Handler &diag,
+                               size_t num_chunks) -> TokenBuffer
+{
+    const char *const src_begin = file.src_begin();
+    const char *const src_end = file.src_end();
+    const auto src_size = static_cast<size_t>(src_end - src_begin);
+
+    std::vector<Chunk> chunks;
+    chunks.reserve(num_chunks);
+    const char *chunk_begin = src_begin;
+    for (size_t i = 1; i < num_chunks && chunk_begin != src_end; ++i)
+    {
+        const char *target = src_begin + src_size * i / num_chunks;
+        const char *boundary = find_chunk_boundary(
+            src_begin, std::max(target, chunk_begin), src_end);
+        if (boundary != src_end)
+        {
+            chunks.emplace_back(file.start_loc, chunk_begin, boundary);
+            chunk_begin = boundary;
+        }
+    }
+    chunks.emplace_back(file.start_loc, chunk_begin, src_end);
+
+    if (chunks.size() == 1)
+        return lex(file, diag);
+
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(chunks.size() - 1);
+        for (size_t i = 1; i < chunks.size(); ++i)
+            workers.emplace_back(lex_chunk, std::cref(file),
+                                 std::cref(diag.source_map),
+                                 std::ref(chunks[i]));
+        lex_chunk(file, diag.source_map, chunks[0]);
+    }
+
+    // Stitches the chunks together in order. `resume` is the offset at which
+    // the next token must start. A chunk is taken as is from the token
+    // starting exactly at `resume`, as the scanner keeps no state other than
+    // its position. Otherwise, the chunk is lexed again with a scanner that is
+    // kept around for as long as chunks keep failing, so that no token, and no
+    // diagnostic, is ever produced twice.
+    TokenBuffer tokens(file.start_loc);
+    size_t num_tokens = 0;
+    for (const Chunk &chunk : chunks)
+        num_tokens += chunk.tokens.size();
+    tokens.reserve(num_tokens);
+
+    size_t resume = 0;
+    std::optional<Scanner> scanner;
+    Token pending; // Token starting at `resume` when `scanner` is engaged.
+
+    for (const Chunk &chunk : chunks)
+    {
+        const auto limit = static_cast<size_t>(chunk.limit - src_begin);
+        if (resume >= limit)
+            continue;
+
+        const size_t first = chunk.tokens.lower_bound(resume);
+        const bool in_sync = first < chunk.tokens.size()
+                                 ? chunk.tokens.offsets[first] == resume
+                                 : chunk.resume == resume;
+
+        if (in_sync && first >= chunk.clean_from)
+        {
+            tokens.append(chunk.tokens, first);
+            resume = chunk.resume;
+            scanner.reset();
+            continue;
+        }
+
+        if (!scanner)
+        {
+            scanner.emplace(file.start_loc, src_begin + resume, src_end, diag);
+            pending = scanner->next_token();
+        }
+        while (token_offset(file, pending) < limit)
+        {
+            tokens.push_back(pending);
+            pending = scanner->next_token();
+        }
+        resume = token_offset(file, pending);
+    }
+
+    return tokens;
+}
+
+auto TokenBuffer::relex(const FileMap &edited_file, const SourceEdit &edit,
+                        diag::Handler &diag) -> RelexedRange
+{
+    cci_expects(edit.offset + edit.replacement.size() <=
+                edited_file.src_view().size());
+    const size_t edit_end = edit.offset + edit.removed_size;
+    const std::ptrdiff_t delta = edit.size_delta();
+
+    // Restarts at the last token before the line the edit is on. Tokens
+    // before it were lexed without looking at anything past the line break,
+    // whereas the ones after it may have looked ahead through any number of
+    // escaped newlines, right into the edit. Edits on the first line restart
+    // from the start of the file.
+    const size_t line_break =
+        find_line_break_before(edited_file.src_begin(), edit.offset);
+    const size_t after_break = lower_bound(line_break);
+    const size_t first = after_break != 0 ? after_break - 1 : 0;
+    const size_t restart = after_break != 0 ? offsets[first] : 0;
+
+    // Old tokens starting past the edit are the ones to resynchronize on.
+    const size_t edited_end = edit.offset + edit.replacement.size();
+    size_t resync = lower_bound(edit_end);
+    bool in_sync = false;
+
+    Scanner scanner(edited_file.start_loc, edited_file.src_begin() + restart,
+                    edited_file.src_end(), diag);
+    TokenBuffer relexed(edited_file.start_loc);
+
+    for (Token tok = scanner.next_token(); tok.is_not(TokenKind::eof);
+         tok = scanner.next_token())
+    {
+        const auto offset =
+            static_cast<size_t>(tok.location() - edited_file.start_loc);
+        if (offset >= edited_end)
+        {
+            const auto old_offset = static_cast<size_t>(
+                static_cast<std::ptrdiff_t>(offset) - delta);
+            while (resync < size() && offsets[resync] < old_offset)
+                ++resync;
+            in_sync = resync < size() && offsets[resync] == old_offset;
+            if (in_sync)
+                break;
+        }
+        relexed.push_back(tok);
+    }
+    if (!in_sync)
+        resync = size();
+
+    // Tokens past the edit keep their offsets from the start of the file,
+    // moved by the size of the edit. They're only moved once spliced after
+    // the relexed tokens, as long tokens are found by offset.
+    const size_t long_first = long_token_idx(first);
+    this->file_loc = edited_file.start_loc;
+    splice(first, resync, relexed);
+    for (size_t i = first + relexed.size(); i < size(); ++i)
+        offsets[i] += static_cast<uint32_t>(delta);
+    for (size_t i = long_first + relexed.long_tokens.size();
+         i < long_tokens.size(); ++i)
+        long_tokens[i].offset += static_cast<uint32_t>(delta);
+    return {first, resync - first, relexed.size()};
+}
+
+auto TokenBuffer::lower_bound(size_t offset) const -> size_t
+{
+    const auto it = std::lower_bound(offsets.begin(), offsets.end(), offset);
+    return static_cast<size_t>(it - offsets.begin());
+}
+
+void TokenBuffer::append(const TokenBuffer &other, size_t first)
+{
+    cci_expects(this->file_loc == other.file_loc);
+    cci_expects(first <= other.size());
+    const auto from = static_cast<std::ptrdiff_t>(first);
+    kinds.insert(kinds.end(), other.kinds.begin() + from, other.kinds.end());
+    offsets.insert(offsets.end(), other.offsets.begin() + from,
+                   other.offsets.end());
+    lengths.insert(lengths.end(), other.lengths.begin() + from,
+                   other.lengths.end());
+    flags.insert(flags.end(), other.flags.begin() + from, other.flags.end());
+
+    const auto long_from =
+        static_cast<std::ptrdiff_t>(other.long_token_idx(first));
+    long_tokens.insert(long_tokens.end(), other.long_tokens.begin() + long_from,
+                       other.long_tokens.end());
+}
+
+void TokenBuffer::splice(size_t first, size_t last, const TokenBuffer &other)
+{
+    cci_expects(first <= last && last <= size());
+    const auto long_first = long_tokens.begin() +
+                            static_cast<std::ptrdiff_t>(long_token_idx(first));
+    const auto long_last = long_tokens.begin() +
+                           static_cast<std::ptrdiff_t>(long_token_idx(last));
+    long_tokens.insert(long_tokens.erase(long_first, long_last),
+                       other.long_tokens.begin(), other.long_tokens.end());
+
+    const auto replace = [&](auto &to, const auto &from) {
+        const auto to_first = to.begin() + static_cast<std::ptrdiff_t>(first);
+        const auto to_last = to.begin() + static_cast<std::ptrdiff_t>(last);
+        const auto common =
+            std::min(to_last - to_first,
+                     static_cast<std::ptrdiff_t>(from.size()));
+        std::copy_n(from.begin(), common, to_first);
+        if (common < to_last - to_first)
+            to.erase(to_first + common, to_last);
+        else
+            to.insert(to_last, from.begin() + common, from.end());
+    };
+    replace(kinds, other.kinds);
+    replace(offsets, other.offsets);
+    replace(lengths, other.lengths);
+    replace(flags, other.flags);
+}
+
+auto TokenBuffer::long_token_idx(size_t idx) const -> size_t
+{
+    if (idx >= size())
+        return long_tokens.size();
+    const auto it = std::lower_bound(
+        long_tokens.begin(), long_tokens.end(), offsets[idx],
+        [](const LongToken &tok, uint32_t offset) {
+            return tok.offset < offset;
+        });
+    return static_cast<size_t>(it - long_tokens.begin());
+}
+
+} // namespace cci::syntax
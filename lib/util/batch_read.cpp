@@ -0,0 +1,493 @@
+#include "cci/util/batch_read.hpp"
+#include "cci/util/contracts.hpp"
+#include "cci/util/file_stream.hpp"
+#include "cci/util/scope_guard.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CCI_HAS_PREAD 1
+#else
+#define CCI_HAS_PREAD 0
+#endif
+
+#if CCI_HAS_PREAD && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define CCI_HAS_IO_URING 1
+#else
+#define CCI_HAS_IO_URING 0
+#endif
+
+namespace cci {
+
+/// Maximum number of threads reading files in the thread pool. Reads mostly
+/// wait on I/O, so this is independent of the number of cores.
+constexpr size_t max_read_threads = 16;
+
+/// Reads the whole file at `file_path`.
+static auto read_whole_file(const fs::path &file_path)
+    -> std::optional<std::string>
+{
+#if CCI_HAS_PREAD
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return std::nullopt;
+    ScopeGuard fd_guard([&] { ::close(fd); });
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+        return std::nullopt;
+
+    std::string contents(static_cast<size_t>(st.st_size), '\0');
+    size_t done = 0;
+    while (done < contents.size())
+    {
+        const ssize_t n = ::pread(fd, contents.data() + done,
+                                  contents.size() - done,
+                                  static_cast<off_t>(done));
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n == -1)
+            return std::nullopt;
+        if (n == 0) // The file got truncated while reading it.
+            break;
+        done += static_cast<size_t>(n);
+    }
+    contents.resize(done);
+    return contents;
+#else
+    return read_stream_utf8(file_path);
+#endif
+}
+
+static void read_with_thread_pool(span<const fs::path> file_paths,
+                                  const BatchReadCallback &on_read)
+{
+    using ReadResult = std::pair<size_t, std::optional<std::string>>;
+    const auto num_files = static_cast<size_t>(file_paths.size());
+
+    std::mutex results_mutex;
+    std::vector<ReadResult> results;
+    std::atomic<size_t> num_results = 0; // Bumped after adding to `results`.
+    std::atomic<size_t> next_file = 0;
+
+    const auto worker = [&] {
+        for (size_t idx = next_file.fetch_add(1); idx < num_files;
+             idx = next_file.fetch_add(1))
+        {
+            auto contents = read_whole_file(file_paths[idx]);
+            {
+                std::lock_guard lock(results_mutex);
+                results.emplace_back(idx, std::move(contents));
+            }
+            num_results.fetch_add(1);
+            num_results.notify_one();
+        }
+    };
+
+    std::vector<std::jthread> threads;
+    const size_t num_threads = std::min(num_files, max_read_threads);
+    threads.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i)
+        threads.emplace_back(worker);
+
+    // Stops the workers early if a callback throws.
+    ScopeGuard stop_guard([&] { next_file = num_files; });
+
+    std::vector<ReadResult> batch;
+    for (size_t num_done = 0; num_done < num_files; num_done += batch.size())
+    {
+        batch.clear();
+        num_results.wait(num_done);
+        {
+            std::lock_guard lock(results_mutex);
+            batch.swap(results);
+        }
+        for (auto &[idx, contents] : batch)
+            on_read(idx, std::move(contents));
+    }
+}
+
+#if CCI_HAS_IO_URING
+
+namespace {
+
+/// A minimal io_uring instance, set up with raw system calls so as to not
+/// depend on liburing.
+struct IoUring
+{
+private:
+    int ring_fd = -1;
+
+    void *sq_ring = MAP_FAILED;
+    size_t sq_ring_size = 0;
+    void *cq_ring = MAP_FAILED;
+    size_t cq_ring_size = 0;
+    void *sqes_map = MAP_FAILED;
+    size_t sqes_size = 0;
+
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned sqe_tail = 0; ///< Tail including the entries not yet submitted.
+    io_uring_sqe *sqes = nullptr;
+
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+
+    void release();
+
+public:
+    explicit IoUring(unsigned entries);
+    ~IoUring() { release(); }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    /// Returns whether the ring was set up, and supports the operations
+    /// needed to read files.
+    auto is_valid() const -> bool { return ring_fd != -1; }
+
+    /// Returns the number of submission queue entries.
+    auto size() const -> size_t { return sq_entries; }
+
+    /// Returns a cleared submission queue entry, or null if the queue is
+    /// full.
+    auto get_sqe() -> io_uring_sqe *;
+
+    /// Submits all queued entries, and waits for at least `min_complete`
+    /// completions.
+    void submit_and_wait(unsigned min_complete);
+
+    /// Calls `f` on every available completion and consumes them.
+    template <typename F>
+    void for_each_cqe(F &&f)
+    {
+        unsigned head = *cq_head;
+        const unsigned tail =
+            std::atomic_ref(*cq_tail).load(std::memory_order_acquire);
+        for (; head != tail; ++head)
+            f(cqes[head & cq_mask]);
+        std::atomic_ref(*cq_head).store(head, std::memory_order_release);
+    }
+};
+
+} // namespace
+
+IoUring::IoUring(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const long fd = ::syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+        return;
+    ring_fd = static_cast<int>(fd);
+
+    // Opening and reading files were only added in Linux 5.6, as was this
+    // feature flag.
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        release();
+        return;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        release();
+        return;
+    }
+
+    if (!single_mmap)
+    {
+        cq_ring =
+            ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED)
+        {
+            release();
+            return;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_map = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_map == MAP_FAILED)
+    {
+        release();
+        return;
+    }
+
+    auto *const sq = static_cast<char *>(sq_ring);
+    auto *const cq = static_cast<char *>(single_mmap ? sq_ring : cq_ring);
+    const auto field = [](char *ring, uint32_t offset) {
+        return reinterpret_cast<unsigned *>(ring + offset);
+    };
+
+    sq_head = field(sq, params.sq_off.head);
+    sq_tail = field(sq, params.sq_off.tail);
+    sq_array = field(sq, params.sq_off.array);
+    sq_mask = *field(sq, params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sqe_tail = *sq_tail;
+    sqes = static_cast<io_uring_sqe *>(sqes_map);
+
+    cq_head = field(cq, params.cq_off.head);
+    cq_tail = field(cq, params.cq_off.tail);
+    cq_mask = *field(cq, params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+void IoUring::release()
+{
+    if (sqes_map != MAP_FAILED)
+        ::munmap(sqes_map, sqes_size);
+    if (cq_ring != MAP_FAILED)
+        ::munmap(cq_ring, cq_ring_size);
+    if (sq_ring != MAP_FAILED)
+        ::munmap(sq_ring, sq_ring_size);
+    if (ring_fd != -1)
+        ::close(ring_fd);
+    sqes_map = cq_ring = sq_ring = MAP_FAILED;
+    ring_fd = -1;
+}
+
+auto IoUring::get_sqe() -> io_uring_sqe *
+{
+    const unsigned head =
+        std::atomic_ref(*sq_head).load(std::memory_order_acquire);
+    if (sqe_tail - head == sq_entries)
+        return nullptr;
+
+    const unsigned idx = sqe_tail & sq_mask;
+    io_uring_sqe *sqe = &sqes[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[idx] = idx;
+    ++sqe_tail;
+    return sqe;
+}
+
+void IoUring::submit_and_wait(unsigned min_complete)
+{
+    std::atomic_ref(*sq_tail).store(sqe_tail, std::memory_order_release);
+    const unsigned to_submit =
+        sqe_tail - std::atomic_ref(*sq_head).load(std::memory_order_acquire);
+    if (to_submit == 0 && min_complete == 0)
+        return;
+    const unsigned flags = min_complete != 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    while (::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                     flags, nullptr, 0) < 0)
+    {
+        // Any other error means the ring was misused. When the kernel is
+        // short on resources, whatever wasn't submitted stays in the queue
+        // for the next call.
+        cci_ensures(errno == EINTR || errno == EAGAIN || errno == EBUSY);
+        if (errno != EINTR)
+            break;
+    }
+}
+
+/// Number of submission queue entries of the ring used to read files, and so
+/// the maximum number of operations in flight.
+constexpr unsigned io_uring_entries = 64;
+
+/// Maximum size of a single read, which must fit in 32 bits.
+constexpr size_t max_read_size = size_t(1) << 30;
+
+/// Reads all files with io_uring. Each file goes through an open and as many
+/// reads as needed, and all files are in some stage at the same time.
+//
+/// \return Whether io_uring was available to read the files.
+static auto read_with_io_uring(span<const fs::path> file_paths,
+                               const BatchReadCallback &on_read) -> bool
+{
+    IoUring ring(io_uring_entries);
+    if (!ring.is_valid())
+        return false;
+
+    struct FileRead
+    {
+        int fd = -1; ///< Open file, or -1 while opening it.
+        std::string contents;
+        size_t done = 0; ///< Number of bytes read so far.
+    };
+
+    using ReadResult = std::pair<size_t, std::optional<std::string>>;
+    const auto num_files = static_cast<size_t>(file_paths.size());
+    std::vector<FileRead> files(num_files);
+    std::vector<size_t> pending_reads; // Files whose next read isn't queued.
+    std::vector<ReadResult> finished;
+    size_t next_open = 0;
+    size_t in_flight = 0;
+
+    const auto finish = [&](size_t idx, bool success) {
+        FileRead &file = files[idx];
+        if (file.fd != -1)
+            ::close(file.fd);
+        std::optional<std::string> contents;
+        if (success)
+        {
+            file.contents.resize(file.done);
+            contents = std::move(file.contents);
+        }
+        file = FileRead();
+        finished.emplace_back(idx, std::move(contents));
+    };
+
+    const auto continue_read = [&](size_t idx) {
+        if (files[idx].done == files[idx].contents.size())
+            finish(idx, true);
+        else
+            pending_reads.push_back(idx);
+    };
+
+    const auto on_complete = [&](const io_uring_cqe &cqe) {
+        --in_flight;
+        const auto idx = static_cast<size_t>(cqe.user_data);
+        FileRead &file = files[idx];
+
+        if (file.fd == -1)
+        {
+            if (cqe.res < 0)
+                return finish(idx, false);
+            file.fd = cqe.res;
+
+            struct stat st;
+            if (::fstat(file.fd, &st) == -1 || !S_ISREG(st.st_mode))
+                return finish(idx, false);
+            file.contents.resize(static_cast<size_t>(st.st_size));
+            return continue_read(idx);
+        }
+
+        if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+            return pending_reads.push_back(idx);
+        if (cqe.res < 0)
+            return finish(idx, false);
+        if (cqe.res == 0) // The file got truncated while reading it.
+            file.contents.resize(file.done);
+        file.done += static_cast<size_t>(cqe.res);
+        continue_read(idx);
+    };
+
+    // The kernel writes into the buffers of the reads in flight, so they must
+    // complete before the buffers go away if a callback throws.
+    ScopeGuard drain_guard([&] {
+        while (in_flight != 0)
+        {
+            ring.submit_and_wait(1);
+            ring.for_each_cqe([&](const io_uring_cqe &cqe) {
+                --in_flight;
+                const auto idx = static_cast<size_t>(cqe.user_data);
+                if (files[idx].fd == -1 && cqe.res >= 0)
+                    ::close(cqe.res);
+            });
+        }
+        for (FileRead &file : files)
+            if (file.fd != -1)
+                ::close(file.fd);
+    });
+
+    // Reads of open files are queued before opening any other, which bounds
+    // the number of files open at a time.
+    const auto queue_requests = [&] {
+        while (in_flight < ring.size() && !pending_reads.empty())
+        {
+            const size_t idx = pending_reads.back();
+            pending_reads.pop_back();
+            FileRead &file = files[idx];
+
+            io_uring_sqe *sqe = ring.get_sqe();
+            cci_ensures(sqe != nullptr);
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = file.fd;
+            sqe->addr = reinterpret_cast<uintptr_t>(file.contents.data() +
+                                                    file.done);
+            sqe->len = static_cast<uint32_t>(
+                std::min(file.contents.size() - file.done, max_read_size));
+            sqe->off = file.done;
+            sqe->user_data = idx;
+            ++in_flight;
+        }
+
+        while (in_flight < ring.size() && next_open < num_files)
+        {
+            io_uring_sqe *sqe = ring.get_sqe();
+            cci_ensures(sqe != nullptr);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uintptr_t>(
+                file_paths[next_open].c_str());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = next_open;
+            ++next_open;
+            ++in_flight;
+        }
+    };
+
+    queue_requests();
+    for (size_t num_done = 0; num_done < num_files;)
+    {
+        ring.submit_and_wait(1);
+        ring.for_each_cqe(on_complete);
+
+        // Follow-up requests are submitted before running the callbacks, so
+        // that they keep going in the meantime.
+        queue_requests();
+        ring.submit_and_wait(0);
+
+        num_done += finished.size();
+        for (auto &[idx, contents] : finished)
+            on_read(idx, std::move(contents));
+        finished.clear();
+    }
+
+    drain_guard.dismiss();
+    return true;
+}
+
+#endif // CCI_HAS_IO_URING
+
+void read_streams_utf8(span<const fs::path> file_paths,
+                       const BatchReadCallback &on_read,
+                       BatchReadBackend backend)
+{
+#if CCI_HAS_IO_URING
+    if (backend == BatchReadBackend::automatic &&
+        read_with_io_uring(file_paths, on_read))
+        return;
+#else
+    static_cast<void>(backend);
+#endif
+    read_with_thread_pool(file_paths, on_read);
+}
+
+} // namespace cci
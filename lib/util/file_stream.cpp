@@ -14,7 +14,7 @@ auto write_stream(const fs::path &file_path, const std::byte *data,
         stream != nullptr)
     {
         ScopeGuard file_guard([&] { std::fclose(stream); });
-        return std::fwrite(data, length, 1, stream) == length;
+        return std::fwrite(data, 1, length, stream) == length;
     }
     else
         return false;
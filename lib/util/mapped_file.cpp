@@ -0,0 +1,98 @@
+#include "cci/util/mapped_file.hpp"
+#include "cci/util/contracts.hpp"
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CCI_HAS_MMAP 1
+#else
+#define CCI_HAS_MMAP 0
+#endif
+
+namespace cci {
+
+MappedFile::~MappedFile()
+{
+#if CCI_HAS_MMAP
+    if (mapping)
+        ::munmap(mapping, mapping_size);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr))
+    , mapping_size(std::exchange(other.mapping_size, 0))
+    , file_size(std::exchange(other.file_size, 0))
+{}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    MappedFile moved(std::move(other));
+    std::swap(this->mapping, moved.mapping);
+    std::swap(this->mapping_size, moved.mapping_size);
+    std::swap(this->file_size, moved.file_size);
+    return *this;
+}
+
+auto MappedFile::open(const fs::path &file_path) -> std::optional<MappedFile>
+{
+#if CCI_HAS_MMAP
+    const int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return std::nullopt;
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    // The whole range is first reserved with zeroed anonymous pages, and the
+    // file is then mapped over the start of it. Bytes past the end of the file
+    // in its last page are zeroed by the kernel, and the pages after that are
+    // the anonymous ones, so the padding is always there, even when the file
+    // size is a multiple of the page size.
+    const auto file_size = static_cast<size_t>(st.st_size);
+    const auto page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t mapping_size =
+        (file_size + padding_size + page_size - 1) / page_size * page_size;
+
+    void *mapping = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    if (file_size != 0 &&
+        ::mmap(mapping, file_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        ::munmap(mapping, mapping_size);
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    ::madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+    return MappedFile(static_cast<char *>(mapping), mapping_size, file_size);
+#else
+    static_cast<void>(file_path);
+    return std::nullopt;
+#endif
+}
+
+void MappedFile::append(char c)
+{
+    cci_expects(mapping != nullptr);
+    cci_expects(file_size + 1 < mapping_size);
+    mapping[file_size++] = c;
+}
+
+} // namespace cci
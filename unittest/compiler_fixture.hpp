@@ -41,7 +41,7 @@ protected:
 
     auto get_source_text(const syntax::Token &tok) const -> std::string_view
     {
-        return source_map.span_to_snippet(tok.source_span);
+        return source_map.span_to_snippet(tok.source_span());
     }
 
     auto get_lexeme_view(const syntax::Token &tok) -> std::string_view
@@ -0,0 +1,178 @@
+#include "cci/syntax/char_scan.hpp"
+#include "gtest/gtest.h"
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <string_view>
+
+using cci::syntax::classify_line_chunk;
+using cci::syntax::count_newlines_and_non_ascii;
+using cci::syntax::count_newlines_and_non_ascii_scalar;
+using cci::syntax::find_block_comment_stop;
+using cci::syntax::find_block_comment_stop_scalar;
+using cci::syntax::find_line_comment_stop;
+using cci::syntax::find_line_comment_stop_scalar;
+using cci::syntax::skip_whitespace;
+using cci::syntax::skip_whitespace_scalar;
+
+namespace {
+
+auto skipped(std::string_view s) -> size_t
+{
+    return static_cast<size_t>(skip_whitespace(s.begin(), s.end()) -
+                               s.begin());
+}
+
+TEST(CharScanTest, skipWhitespaceStopsAtFirstNonWhitespace)
+{
+    EXPECT_EQ(0, skipped(""));
+    EXPECT_EQ(0, skipped("foo"));
+    EXPECT_EQ(3, skipped(" \t\nfoo"));
+    EXPECT_EQ(6, skipped(" \v\f\r\n\tx"));
+    EXPECT_EQ(5, skipped("     "));
+}
+
+TEST(CharScanTest, skipWhitespaceStopsAtEscapesAndTrigraphs)
+{
+    EXPECT_EQ(4, skipped("    \\\n"));
+    EXPECT_EQ(2, skipped("  \?\?/\n"));
+    EXPECT_EQ(40, skipped(std::string(40, ' ') + "\\\n"));
+    EXPECT_EQ(33, skipped(std::string(33, '\n') + "\?\?/\n"));
+}
+
+TEST(CharScanTest, skipWhitespaceDoesNotReadPastEnd)
+{
+    const std::string source = std::string(100, ' ') + "x";
+    for (size_t len = 0; len <= 100; ++len)
+    {
+        const char *end = source.data() + len;
+        EXPECT_EQ(end, skip_whitespace(source.data(), end)) << "len: " << len;
+    }
+}
+
+TEST(CharScanTest, skipWhitespaceMatchesScalarVersion)
+{
+    // Places a non-whitespace character at every position of a buffer that
+    // spans a few blocks, so each lane of a block gets exercised.
+    const std::string_view fill = " \t\n\v\f\r";
+    for (size_t pos = 0; pos < 100; ++pos)
+    {
+        std::string source;
+        for (size_t i = 0; i < 100; ++i)
+            source.push_back(fill[i % fill.size()]);
+        source[pos] = "x\\?\0\x80"[pos % 5];
+
+        const char *begin = source.data();
+        const char *end = begin + source.size();
+        EXPECT_EQ(skip_whitespace_scalar(begin, end),
+                  skip_whitespace(begin, end))
+            << "pos: " << pos;
+    }
+}
+
+TEST(CharScanTest, findLineCommentStop)
+{
+    auto stop = [](std::string_view s) {
+        return find_line_comment_stop(s.begin(), s.end()) - s.begin();
+    };
+
+    EXPECT_EQ(3, stop("foo"));
+    EXPECT_EQ(11, stop("// a */ b /\nc"));
+    EXPECT_EQ(1, stop("a\r\n"));
+    EXPECT_EQ(2, stop("ab\\\n"));
+    EXPECT_EQ(40, stop(std::string(40, '*') + "\?\?/\n"));
+    EXPECT_EQ(33, stop(std::string(33, ' ') + std::string(1, '\0')));
+}
+
+TEST(CharScanTest, findBlockCommentStop)
+{
+    auto stop = [](std::string_view s) {
+        return find_block_comment_stop(s.begin(), s.end()) - s.begin();
+    };
+
+    EXPECT_EQ(3, stop("foo"));
+    EXPECT_EQ(4, stop("\n**\n/"));
+    EXPECT_EQ(2, stop("ab\\\n"));
+    EXPECT_EQ(40, stop(std::string(40, '*') + "\?\?/\n"));
+    EXPECT_EQ(51, stop(std::string(50, '\n') + "*/"));
+}
+
+TEST(CharScanTest, findCommentStopsMatchScalarVersions)
+{
+    const std::string_view stops = "\n\r\\?/";
+    for (size_t pos = 0; pos < 100; ++pos)
+    {
+        std::string source(100, '*');
+        source[pos] = stops[pos % stops.size()];
+
+        const char *begin = source.data();
+        const char *end = begin + source.size();
+        EXPECT_EQ(find_line_comment_stop_scalar(begin, end),
+                  find_line_comment_stop(begin, end))
+            << "pos: " << pos;
+        EXPECT_EQ(find_block_comment_stop_scalar(begin, end),
+                  find_block_comment_stop(begin, end))
+            << "pos: " << pos;
+    }
+}
+
+TEST(CharScanTest, countNewlinesAndNonAscii)
+{
+    auto counts = [](std::string_view s) {
+        const auto c = count_newlines_and_non_ascii(s.begin(), s.end());
+        return std::pair(c.newlines, c.non_ascii);
+    };
+
+    EXPECT_EQ((std::pair<size_t, size_t>(0, 0)), counts(""));
+    EXPECT_EQ((std::pair<size_t, size_t>(2, 0)), counts("a\nb\n"));
+    EXPECT_EQ((std::pair<size_t, size_t>(1, 12)), counts("строка\n"));
+    EXPECT_EQ((std::pair<size_t, size_t>(40, 0)),
+              counts(std::string(40, '\n')));
+    EXPECT_EQ((std::pair<size_t, size_t>(1, 99)),
+              counts("\n" + std::string(99, '\xE4')));
+}
+
+TEST(CharScanTest, classifyLineChunk)
+{
+    std::string chunk(cci::syntax::line_chunk_size, 'x');
+    chunk[0] = '\n';
+    chunk[31] = '\xE4';
+    chunk[32] = '\n';
+    chunk[63] = '\x80';
+
+    const auto masks = classify_line_chunk(chunk.data());
+    EXPECT_EQ((uint64_t(1) << 0) | (uint64_t(1) << 32), masks.newlines);
+    EXPECT_EQ((uint64_t(1) << 31) | (uint64_t(1) << 63), masks.non_ascii);
+}
+
+TEST(CharScanTest, classifyLineChunkMatchesCounts)
+{
+    const std::string_view interesting = "\n\x80\xC3\xFF";
+    for (size_t pos = 0; pos < cci::syntax::line_chunk_size; ++pos)
+    {
+        std::string chunk(cci::syntax::line_chunk_size, 'x');
+        chunk[pos] = interesting[pos % interesting.size()];
+        chunk[(pos * 7) % chunk.size()] = interesting[pos % 3];
+
+        const auto masks = classify_line_chunk(chunk.data());
+        const auto counts = count_newlines_and_non_ascii_scalar(
+            chunk.data(), chunk.data() + chunk.size());
+        EXPECT_EQ(counts.newlines, std::popcount(masks.newlines))
+            << "pos: " << pos;
+        EXPECT_EQ(counts.non_ascii, std::popcount(masks.non_ascii))
+            << "pos: " << pos;
+        for (size_t i = 0; i < chunk.size(); ++i)
+        {
+            EXPECT_EQ(chunk[i] == '\n', (masks.newlines >> i) & 1)
+                << "pos: " << pos << ", i: " << i;
+        }
+
+        const auto bulk = count_newlines_and_non_ascii(
+            chunk.data(), chunk.data() + chunk.size());
+        EXPECT_EQ(counts.newlines, bulk.newlines) << "pos: " << pos;
+        EXPECT_EQ(counts.non_ascii, bulk.non_ascii) << "pos: " << pos;
+    }
+}
+
+} // namespace
@@ -0,0 +1,189 @@
+#include "cci/syntax/concurrent_handler.hpp"
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using cci::diag::ConcurrentHandler;
+using cci::diag::Diag;
+using cci::diag::Diagnostic;
+using cci::diag::Handler;
+using cci::syntax::ByteLoc;
+using cci::syntax::SourceMap;
+
+namespace {
+
+constexpr size_t num_tus = 6;
+constexpr size_t diags_per_tu = 500;
+
+using Emitted = std::tuple<const SourceMap *, ByteLoc, char>;
+
+struct ConcurrentHandlerTest : ::testing::Test
+{
+protected:
+    // One source map per translation unit, each of them with a single file.
+    std::vector<SourceMap> source_maps = std::vector<SourceMap>(num_tus);
+    std::vector<Emitted> emitted;
+    ConcurrentHandler handler{[this](const Diagnostic &d) {
+        emitted.emplace_back(d.source_map, d.loc, std::get<char>(d.args[0]));
+    }};
+
+    ConcurrentHandlerTest()
+    {
+        for (SourceMap &map : source_maps)
+            map.create_owned_filemap("tu.c", std::string(diags_per_tu, 'x'));
+    }
+
+    // Reports the diagnostics of translation unit `tu` from a few threads at
+    // once, each at its own locations, in a shuffled order.
+    void report_tu(size_t tu, size_t num_threads)
+    {
+        std::vector<std::jthread> threads;
+        for (size_t t = 0; t < num_threads; ++t)
+        {
+            threads.emplace_back([&, tu, t] {
+                Handler diag(handler.make_emitter(tu), source_maps[tu]);
+                std::vector<size_t> offsets;
+                for (size_t i = t; i < diags_per_tu; i += num_threads)
+                    offsets.push_back(i);
+                std::shuffle(offsets.begin(), offsets.end(),
+                             std::mt19937(static_cast<unsigned>(tu * 31 + t)));
+
+                for (const size_t offset : offsets)
+                {
+                    diag.report(ByteLoc(offset), Diag::unknown_character)
+                        .args(static_cast<char>('a' + tu));
+                }
+            });
+        }
+    }
+
+    // Returns what should have been emitted for all translation units
+    // before `tu_end`.
+    auto expected_until(size_t tu_end) -> std::vector<Emitted>
+    {
+        std::vector<Emitted> expected;
+        for (size_t tu = 0; tu < tu_end; ++tu)
+        {
+            for (size_t offset = 0; offset < diags_per_tu; ++offset)
+            {
+                expected.emplace_back(&source_maps[tu], ByteLoc(offset),
+                                      static_cast<char>('a' + tu));
+            }
+        }
+        return expected;
+    }
+};
+
+TEST_F(ConcurrentHandlerTest, emitsByTranslationUnitThenLocation)
+{
+    // Translation units are compiled in reverse, each by a few threads.
+    {
+        std::vector<std::jthread> tus;
+        for (size_t tu = num_tus; tu-- != 0;)
+            tus.emplace_back([&, tu] { report_tu(tu, 1 + tu % 3); });
+    }
+
+    EXPECT_EQ(0, handler.emitted_count());
+    handler.emit_all();
+    EXPECT_EQ(expected_until(num_tus), emitted);
+    EXPECT_EQ(num_tus * diags_per_tu, handler.emitted_count());
+
+    handler.emit_all();
+    EXPECT_EQ(num_tus * diags_per_tu, emitted.size());
+}
+
+TEST_F(ConcurrentHandlerTest, collectsWhileThreadsReport)
+{
+    std::atomic<bool> done = false;
+    std::jthread reporter([&] {
+        for (size_t tu = 0; tu < num_tus; ++tu)
+            report_tu(tu, 2);
+        done = true;
+    });
+
+    while (!done)
+        handler.collect();
+    reporter.join();
+
+    handler.emit_all();
+    EXPECT_EQ(expected_until(num_tus), emitted);
+}
+
+TEST_F(ConcurrentHandlerTest, emitsFinishedTranslationUnitsOnly)
+{
+    report_tu(0, 2);
+    report_tu(1, 2);
+    std::jthread late([&] { report_tu(3, 2); });
+
+    handler.emit_finished(2);
+    EXPECT_EQ(expected_until(2), emitted);
+
+    late.join();
+    report_tu(2, 1);
+    handler.emit_finished(4);
+    EXPECT_EQ(expected_until(4), emitted);
+}
+
+TEST_F(ConcurrentHandlerTest, freesQueuesOnceClosedAndDrained)
+{
+    Handler open_diag(handler.make_emitter(1), source_maps[1]);
+    open_diag.report(ByteLoc(0), Diag::unknown_character).args('b');
+    for (size_t round = 0; round < 3; ++round)
+    {
+        report_tu(0, 4);
+        EXPECT_EQ(5, handler.queue_count());
+
+        // Closed queues are freed, even before their diagnostics are emitted.
+        handler.collect();
+        EXPECT_EQ(1, handler.queue_count());
+    }
+
+    // Copies of an emitter keep its queue open.
+    auto emitter = handler.make_emitter(1);
+    {
+        Handler diag(emitter, source_maps[1]);
+        diag.report(ByteLoc(1), Diag::unknown_character).args('b');
+    }
+    handler.collect();
+    EXPECT_EQ(2, handler.queue_count());
+    emitter = nullptr;
+    handler.collect();
+    EXPECT_EQ(1, handler.queue_count());
+
+    handler.emit_finished(1);
+    EXPECT_EQ(expected_until(1).size() * 3, handler.emitted_count());
+    handler.emit_all();
+    EXPECT_EQ(1, handler.queue_count());
+    EXPECT_EQ(expected_until(1).size() * 3 + 2, handler.emitted_count());
+}
+
+TEST_F(ConcurrentHandlerTest, tiesAreBrokenByArguments)
+{
+    {
+        std::vector<std::jthread> threads;
+        for (const char c : {'z', 'b', 'y', 'a'})
+        {
+            threads.emplace_back([&, c] {
+                Handler diag(handler.make_emitter(0), source_maps[0]);
+                diag.report(ByteLoc(1), Diag::unknown_character).args(c);
+            });
+        }
+    }
+
+    handler.emit_all();
+    ASSERT_EQ(4, emitted.size());
+    EXPECT_EQ('a', std::get<2>(emitted[0]));
+    EXPECT_EQ('b', std::get<2>(emitted[1]));
+    EXPECT_EQ('y', std::get<2>(emitted[2]));
+    EXPECT_EQ('z', std::get<2>(emitted[3]));
+}
+
+} // namespace
@@ -0,0 +1,148 @@
+#include "cci/syntax/diagnostics.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "gtest/gtest.h"
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using cci::diag::Diag;
+using cci::diag::Diagnostic;
+using cci::diag::Handler;
+using cci::syntax::ByteLoc;
+using cci::syntax::ByteSpan;
+using cci::syntax::CharPos;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+namespace {
+
+struct DiagnosticHandlerTest : ::testing::Test
+{
+protected:
+    SourceMap source_map;
+    ByteLoc start_loc =
+        source_map.create_owned_filemap("test.c", "int x = (y + ;\n")
+            .start_loc;
+
+    // Addresses of the emitted diagnostics, and copies of them.
+    std::vector<const Diagnostic *> addresses;
+    std::vector<Diagnostic> emitted;
+
+    Handler diag{[this](const Diagnostic &d) {
+                     addresses.push_back(&d);
+                     emitted.push_back(d);
+                 },
+                 source_map};
+};
+
+TEST_F(DiagnosticHandlerTest, reportKeepsArgsAndRanges)
+{
+    diag.report(start_loc + ByteLoc(13), Diag::expected_but_got)
+        .args(TokenKind::r_paren, TokenKind::semi, 'x')
+        .ranges({ByteSpan(start_loc + ByteLoc(8), start_loc + ByteLoc(13)),
+                 ByteSpan(start_loc, start_loc + ByteLoc(3))});
+
+    ASSERT_EQ(1, emitted.size());
+    EXPECT_EQ(1, diag.err_count());
+    EXPECT_EQ(Diag::expected_but_got, emitted[0].msg);
+    EXPECT_EQ(start_loc + ByteLoc(13), emitted[0].loc);
+    EXPECT_EQ(1, emitted[0].source_location().line);
+    EXPECT_EQ(CharPos(13), emitted[0].source_location().column);
+    ASSERT_EQ(3, emitted[0].args.size());
+    EXPECT_EQ(Diagnostic::Arg(TokenKind::r_paren), emitted[0].args[0]);
+    EXPECT_EQ(Diagnostic::Arg(TokenKind::semi), emitted[0].args[1]);
+    EXPECT_EQ(Diagnostic::Arg('x'), emitted[0].args[2]);
+    ASSERT_EQ(2, emitted[0].ranges.size());
+    EXPECT_EQ(start_loc + ByteLoc(8), emitted[0].ranges[0].start);
+    EXPECT_EQ(start_loc, emitted[0].ranges[1].start);
+}
+
+TEST_F(DiagnosticHandlerTest, emittedDiagnosticsAreReused)
+{
+    diag.report(start_loc, Diag::unknown_character)
+        .args('@', '@', '@', '@', '@', '@');
+    diag.report(start_loc + ByteLoc(4), Diag::invalid_digit).args('9');
+
+    ASSERT_EQ(2, emitted.size());
+    EXPECT_EQ(addresses[0], addresses[1]);
+
+    // Nothing is left over from the first diagnostic.
+    EXPECT_EQ(Diag::invalid_digit, emitted[1].msg);
+    EXPECT_EQ(start_loc + ByteLoc(4), emitted[1].loc);
+    ASSERT_EQ(1, emitted[1].args.size());
+    EXPECT_EQ(Diagnostic::Arg('9'), emitted[1].args[0]);
+    EXPECT_TRUE(emitted[1].ranges.empty());
+}
+
+TEST_F(DiagnosticHandlerTest, nestedReportsUseDistinctDiagnostics)
+{
+    {
+        auto outer = diag.report(start_loc, Diag::unknown_character);
+        outer.args('a');
+        diag.report(start_loc + ByteLoc(1), Diag::unknown_character).args('b');
+    }
+
+    ASSERT_EQ(2, emitted.size());
+    EXPECT_NE(addresses[0], addresses[1]);
+    EXPECT_EQ(Diagnostic::Arg('b'), emitted[0].args[0]);
+    EXPECT_EQ(Diagnostic::Arg('a'), emitted[1].args[0]);
+}
+
+TEST_F(DiagnosticHandlerTest, movedFromBuilderDoesNotEmit)
+{
+    {
+        auto builder = diag.report(start_loc, Diag::unknown_character);
+        auto moved = std::move(builder);
+        moved.args('a');
+    }
+
+    ASSERT_EQ(1, emitted.size());
+    EXPECT_EQ(1, diag.err_count());
+    EXPECT_EQ(Diagnostic::Arg('a'), emitted[0].args[0]);
+}
+
+// Builders only let exceptions through when contracts are enabled.
+#if CCI_CONTRACTS
+TEST_F(DiagnosticHandlerTest, slotIsReleasedWhenEmitterThrows)
+{
+    const Diagnostic *thrown_from = nullptr;
+    diag.set_emitter([&](const Diagnostic &d) {
+        thrown_from = &d;
+        throw std::runtime_error("emitter failed");
+    });
+    EXPECT_THROW(diag.report(start_loc, Diag::unknown_character).args('a'),
+                 std::runtime_error);
+    EXPECT_EQ(0, diag.err_count());
+
+    diag.set_emitter([this](const Diagnostic &d) {
+        addresses.push_back(&d);
+        emitted.push_back(d);
+    });
+    diag.report(start_loc, Diag::unknown_character).args('b');
+    ASSERT_EQ(1, emitted.size());
+    EXPECT_EQ(thrown_from, addresses[0]);
+    EXPECT_EQ(Diagnostic::Arg('b'), emitted[0].args[0]);
+}
+#endif
+
+TEST_F(DiagnosticHandlerTest, locationsAreResolvedOnDemand)
+{
+    const auto &fm = source_map.create_owned_filemap("lazy.c", "a\n @\n");
+    Handler ignoring(cci::diag::ignoring_emitter(), source_map);
+    ignoring.report(fm.start_loc + ByteLoc(3), Diag::unknown_character);
+    EXPECT_EQ(1, ignoring.err_count());
+    EXPECT_FALSE(fm.source_file().has_source_index());
+
+    diag.report(fm.start_loc + ByteLoc(3), Diag::unknown_character);
+    ASSERT_EQ(1, emitted.size());
+    EXPECT_FALSE(fm.source_file().has_source_index());
+
+    const auto loc = emitted[0].source_location();
+    EXPECT_TRUE(fm.source_file().has_source_index());
+    EXPECT_EQ(&fm, &loc.file);
+    EXPECT_EQ(2, loc.line);
+    EXPECT_EQ(CharPos(1), loc.column);
+}
+
+} // namespace
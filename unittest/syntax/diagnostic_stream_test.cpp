@@ -0,0 +1,302 @@
+#include "cci/syntax/diagnostic_stream.hpp"
+#include "cci/syntax/diagnostics_new.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "cci/util/file_stream.hpp"
+#include "gtest/gtest.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using cci::diag2::Diagnostic;
+using cci::diag2::DiagnosticArg;
+using cci::diag2::DiagnosticBag;
+using cci::diag2::DiagnosticBuilder;
+using cci::diag2::DiagnosticDescriptor;
+using cci::diag2::DiagnosticParam;
+using cci::diag2::DiagnosticParamKind;
+using cci::diag2::DiagnosticReader;
+using cci::diag2::DiagnosticRecord;
+using cci::diag2::DiagnosticWriter;
+using cci::diag2::IntArg;
+using cci::diag2::StrArg;
+using cci::diag2::TokenKindArg;
+using cci::syntax::ByteLoc;
+using cci::syntax::ByteSpan;
+using cci::syntax::SourceMap;
+using cci::syntax::TokenKind;
+
+namespace {
+
+constexpr DiagnosticDescriptor redefinition{
+    .message = "redefinition of '{name}' as {kind} (was {line}, {unknown})",
+    .params =
+        {
+            DiagnosticParam("name", DiagnosticParamKind::Str),
+            DiagnosticParam("kind", DiagnosticParamKind::TokenKind),
+            DiagnosticParam("line", DiagnosticParamKind::Int),
+        },
+};
+
+constexpr DiagnosticDescriptor unused{
+    .message = "unused {what}",
+    .params = {DiagnosticParam("what", DiagnosticParamKind::Str)},
+};
+
+constexpr const DiagnosticDescriptor *catalog[] = {&unused, &redefinition};
+
+struct DiagnosticStreamTest : ::testing::Test
+{
+protected:
+    SourceMap source_map;
+    const ByteLoc main_loc =
+        source_map.create_owned_filemap("main.c", "int a;\nstruct a;\n")
+            .start_loc;
+    const ByteLoc header_loc =
+        source_map.create_owned_filemap("α.h", "// x\n\xce\xb1 b;\n")
+            .start_loc;
+
+    auto make_bag() -> DiagnosticBag
+    {
+        DiagnosticBag bag;
+        bag.add(DiagnosticBuilder<redefinition>()
+                    .caret_at(main_loc + ByteLoc(14))
+                    .with_span(ByteSpan(main_loc + ByteLoc(7),
+                                        main_loc + ByteLoc(13)))
+                    .with_span(ByteSpan(header_loc + ByteLoc(5),
+                                        header_loc + ByteLoc(7)))
+                    .with_arg("name", "a")
+                    .with_arg("kind", TokenKind::kw_struct)
+                    .with_arg("line", -1)
+                    .build());
+        bag.add(DiagnosticBuilder<unused>()
+                    .caret_at(header_loc + ByteLoc(8))
+                    .with_arg("what", "variable")
+                    .build());
+        bag.add(DiagnosticBuilder<unused>().build());
+        bag.add(DiagnosticBuilder<redefinition>()
+                    .caret_at(main_loc)
+                    .with_arg("line", 123456789)
+                    .build());
+        return bag;
+    }
+
+    // Records refer to their reader, so these live as long as the test.
+    std::deque<DiagnosticReader> readers;
+
+    auto read_all(span<const std::byte> stream)
+        -> std::vector<DiagnosticRecord>
+    {
+        DiagnosticReader &reader = readers.emplace_back(stream, catalog);
+        std::vector<DiagnosticRecord> records;
+        while (auto record = reader.next())
+            records.push_back(*record);
+        EXPECT_FALSE(reader.is_malformed());
+        return records;
+    }
+};
+
+TEST_F(DiagnosticStreamTest, renderText)
+{
+    std::string text;
+    for (const Diagnostic &diag : make_bag())
+        cci::diag2::render_text(diag, source_map, text);
+
+    EXPECT_EQ("main.c:2:8: redefinition of 'a' as struct (was -1, {unknown})\n"
+              "α.h:2:3: unused variable\n"
+              "unused {what}\n"
+              "main.c:1:1: redefinition of '{name}' as {kind} "
+              "(was 123456789, {unknown})\n",
+              text);
+}
+
+TEST_F(DiagnosticStreamTest, roundTrip)
+{
+    DiagnosticWriter writer(source_map, catalog);
+    writer.write(make_bag());
+    const auto records = read_all(writer.data());
+    ASSERT_EQ(4, records.size());
+
+    const DiagnosticRecord &r = records[0];
+    EXPECT_EQ(&redefinition, r.descriptor);
+    ASSERT_TRUE(r.caret.has_value());
+    EXPECT_EQ("main.c", r.caret->file_name);
+    EXPECT_EQ(14, r.caret->offset);
+    EXPECT_EQ(2, r.caret->line);
+    EXPECT_EQ(8, r.caret->column);
+
+    ASSERT_EQ(2, r.span_count());
+    EXPECT_EQ("main.c", r.span_at(0).file_name);
+    EXPECT_EQ(7, r.span_at(0).offset);
+    EXPECT_EQ(6, r.span_at(0).size);
+    EXPECT_EQ("α.h", r.span_at(1).file_name);
+    EXPECT_EQ(5, r.span_at(1).offset);
+    EXPECT_EQ(2, r.span_at(1).size);
+
+    EXPECT_EQ(DiagnosticArg(StrArg("a")), r.arg(0));
+    EXPECT_EQ(DiagnosticArg(TokenKindArg(TokenKind::kw_struct)), r.arg(1));
+    EXPECT_EQ(DiagnosticArg(IntArg(-1)), r.arg(2));
+    EXPECT_FALSE(r.arg(3).has_value());
+
+    EXPECT_EQ(&unused, records[1].descriptor);
+    EXPECT_EQ("α.h", records[1].caret->file_name);
+    EXPECT_EQ(0, records[1].span_count());
+    EXPECT_FALSE(records[2].caret.has_value());
+    EXPECT_FALSE(records[2].arg(0).has_value());
+    EXPECT_EQ(DiagnosticArg(IntArg(123456789)), records[3].arg(2));
+    EXPECT_FALSE(records[3].arg(0).has_value());
+}
+
+TEST_F(DiagnosticStreamTest, renderedRecordsMatchText)
+{
+    const DiagnosticBag bag = make_bag();
+    std::string text;
+    DiagnosticWriter writer(source_map, catalog);
+    for (const Diagnostic &diag : bag)
+    {
+        cci::diag2::render_text(diag, source_map, text);
+        writer.write(diag);
+    }
+
+    std::string rendered;
+    for (const DiagnosticRecord &record : read_all(writer.data()))
+        record.render(rendered);
+    EXPECT_EQ(text, rendered);
+}
+
+TEST_F(DiagnosticStreamTest, fileNamesAreWrittenOnce)
+{
+    DiagnosticWriter writer(source_map, catalog);
+    writer.write(make_bag());
+    const size_t size = writer.data().size();
+    writer.write(make_bag());
+
+    const auto stream = writer.data();
+    const std::string_view bytes(reinterpret_cast<const char *>(stream.data()),
+                                 stream.size());
+    EXPECT_EQ(bytes.find("main.c"), bytes.rfind("main.c"));
+    EXPECT_EQ(bytes.find("α.h"), bytes.rfind("α.h"));
+    EXPECT_GT(size, bytes.find("α.h"));
+    EXPECT_EQ(8, read_all(stream).size());
+}
+
+TEST_F(DiagnosticStreamTest, savedStreamCanBeRead)
+{
+    DiagnosticWriter writer(source_map, catalog);
+    writer.write(make_bag());
+
+    const auto path = fs::temp_directory_path() / "cci_diagnostic_stream.bin";
+    ASSERT_TRUE(writer.save(path));
+    const auto stream = cci::read_stream_binary(path);
+    fs::remove(path);
+    ASSERT_TRUE(stream.has_value());
+    EXPECT_TRUE(std::equal(stream->begin(), stream->end(),
+                           writer.data().begin(), writer.data().end()));
+
+    std::vector<std::byte> copy;
+    ASSERT_TRUE(cci::write_stream(copy, writer.data().data(),
+                                  writer.data().size()));
+    EXPECT_EQ(4, read_all(copy).size());
+}
+
+TEST_F(DiagnosticStreamTest, malformedStreamsStopReading)
+{
+    DiagnosticWriter writer(source_map, catalog);
+    writer.write(make_bag());
+    const auto stream = writer.data();
+
+    // Every truncation of the stream reads a prefix of the diagnostics,
+    // and is reported as malformed unless it ends right after the header or
+    // a record. There are two file records, and four diagnostic records,
+    // the last of which ends the stream.
+    size_t num_complete = 0;
+    for (std::ptrdiff_t size = 0; size < stream.size(); ++size)
+    {
+        DiagnosticReader reader(stream.first(size), catalog);
+        size_t num_read = 0;
+        while (reader.next())
+            ++num_read;
+        EXPECT_LE(num_read, 4);
+        if (!reader.is_malformed())
+            ++num_complete;
+    }
+    EXPECT_EQ(6, num_complete);
+
+    // A catalog smaller than the writer's is rejected.
+    DiagnosticReader reader(
+        stream, span<const DiagnosticDescriptor *const>(catalog, 1));
+    EXPECT_TRUE(reader.is_malformed());
+    EXPECT_FALSE(reader.next().has_value());
+}
+
+// Appends `value` to `out` as a LEB128 varint.
+void put_varint(std::vector<std::byte> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(std::byte((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(std::byte(value));
+}
+
+// Returns a stream holding a `redefinition` diagnostic whose only argument is
+// of parameter `param`, and of `kind` and encoded `value` as given.
+auto stream_with_arg(size_t param, DiagnosticParamKind kind, uint64_t value)
+    -> std::vector<std::byte>
+{
+    std::vector<std::byte> record;
+    put_varint(record, 1); // descriptor
+    put_varint(record, 0); // flags
+    put_varint(record, 0); // spans
+    put_varint(record, 1); // arguments
+    put_varint(record, param);
+    put_varint(record, static_cast<uint64_t>(kind));
+    put_varint(record, value);
+
+    std::vector<std::byte> stream{std::byte('C'), std::byte('C'),
+                                  std::byte('I'), std::byte('D')};
+    put_varint(stream, 1); // version
+    put_varint(stream, std::size(catalog));
+    stream.push_back(std::byte('D'));
+    put_varint(stream, record.size());
+    stream.insert(stream.end(), record.begin(), record.end());
+    return stream;
+}
+
+TEST_F(DiagnosticStreamTest, argumentsOutOfRangeAreMalformed)
+{
+    using Kind = DiagnosticParamKind;
+    const auto eof = static_cast<uint64_t>(TokenKind::eof);
+
+    // Zigzag encoding maps INT_MAX to 2^32 - 2, and INT_MIN to 2^32 - 1.
+    const auto int_min = uint64_t{std::numeric_limits<uint32_t>::max()};
+    const auto int_max = int_min - 1;
+
+    const auto kind_arg = stream_with_arg(1, Kind::TokenKind, eof);
+    const auto max_arg = stream_with_arg(2, Kind::Int, int_max);
+    const auto min_arg = stream_with_arg(2, Kind::Int, int_min);
+    EXPECT_EQ(DiagnosticArg(TokenKindArg(TokenKind::eof)),
+              read_all(kind_arg).at(0).arg(1));
+    EXPECT_EQ(DiagnosticArg(IntArg(std::numeric_limits<int>::max())),
+              read_all(max_arg).at(0).arg(2));
+    EXPECT_EQ(DiagnosticArg(IntArg(std::numeric_limits<int>::min())),
+              read_all(min_arg).at(0).arg(2));
+
+    for (const auto &stream :
+         {stream_with_arg(1, Kind::TokenKind, eof + 1),
+          stream_with_arg(2, Kind::Int, int_min + 1),
+          stream_with_arg(2, Kind::Int, int_min + 2)})
+    {
+        DiagnosticReader reader(stream, catalog);
+        EXPECT_FALSE(reader.next().has_value());
+        EXPECT_TRUE(reader.is_malformed());
+    }
+}
+
+} // namespace
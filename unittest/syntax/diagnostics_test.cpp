@@ -2,7 +2,9 @@
 #include "cci/syntax/source_map.hpp"
 #include "cci/syntax/token.hpp"
 #include "gtest/gtest.h"
+#include <string>
 #include <string_view>
+#include <utility>
 
 using namespace std::string_view_literals;
 
@@ -12,6 +14,7 @@ using cci::diag2::DiagnosticBag;
 using cci::diag2::DiagnosticBuilder;
 using cci::diag2::DiagnosticDescriptor;
 using cci::diag2::DiagnosticParam;
+using cci::diag2::DiagnosticParamRef;
 using cci::diag2::DiagnosticParamKind;
 using cci::diag2::IntArg;
 using cci::diag2::StrArg;
@@ -22,42 +25,61 @@ using cci::syntax::TokenKind;
 
 namespace {
 
-struct DiagnosticsTest : ::testing::Test
-{
-protected:
-    auto make_descriptor() -> DiagnosticDescriptor
-    {
-        return {
-            .message = "a diagnostic description",
-            .params = {},
-        };
-    }
-
-    auto make_custom_descriptor(std::string_view message)
-        -> DiagnosticDescriptor
-    {
-        return {
-            .message = message,
-            .params = {},
-        };
-    }
-
-    auto build_diag(const DiagnosticDescriptor &descriptor) -> Diagnostic
-    {
-        return DiagnosticBuilder(descriptor).build();
-    }
+constexpr DiagnosticDescriptor descriptor{
+    .message = "a diagnostic description",
+    .params = {},
+};
+
+constexpr DiagnosticDescriptor descriptor_a{
+    .message = "message A",
+    .params = {},
+};
+
+constexpr DiagnosticDescriptor descriptor_b{
+    .message = "message B",
+    .params = {},
+};
+
+constexpr DiagnosticDescriptor descriptor_with_params{
+    .message = "a diagnostic description",
+    .params =
+        {
+            DiagnosticParam("a", DiagnosticParamKind::Int),
+            DiagnosticParam("b", DiagnosticParamKind::Str),
+            DiagnosticParam("c", DiagnosticParamKind::TokenKind),
+        },
 };
 
-TEST_F(DiagnosticsTest, initialDiagnosticBagIsEmpty)
+// Parameter names are resolved at compile time.
+static_assert(descriptor_with_params.params.size() == 3);
+static_assert(
+    DiagnosticParamRef<descriptor_with_params, DiagnosticParamKind::Str>("b")
+        .index == 1);
+static_assert(
+    DiagnosticParamRef<descriptor_with_params, DiagnosticParamKind::TokenKind>(
+        "c")
+        .index == 2);
+
+// String arguments are borrowed, so temporary strings are rejected.
+template <typename Arg>
+concept accepts_str_arg =
+    requires(DiagnosticBuilder<descriptor_with_params> builder, Arg &&arg) {
+        builder.with_arg("b", std::forward<Arg>(arg));
+    };
+static_assert(accepts_str_arg<const char *>);
+static_assert(accepts_str_arg<std::string_view>);
+static_assert(accepts_str_arg<const std::string &>);
+static_assert(!accepts_str_arg<std::string>);
+
+TEST(DiagnosticsTest, initialDiagnosticBagIsEmpty)
 {
     const auto bag = DiagnosticBag();
     EXPECT_EQ(true, bag.empty());
 }
 
-TEST_F(DiagnosticsTest, addingToDiagnosticBagMakesItNonEmpty)
+TEST(DiagnosticsTest, addingToDiagnosticBagMakesItNonEmpty)
 {
-    auto custom_descriptor = make_descriptor();
-    auto diag = DiagnosticBuilder(custom_descriptor).build();
+    auto diag = DiagnosticBuilder<descriptor>().build();
     auto bag = DiagnosticBag();
 
     bag.add(std::move(diag));
@@ -66,13 +88,10 @@ TEST_F(DiagnosticsTest, addingToDiagnosticBagMakesItNonEmpty)
 }
 
 // TODO: This is a DiagnosticBagIterator test, so move it to a better place.
-TEST_F(DiagnosticsTest, diagnosticBagBeginPointsToFirstDiagnostic)
+TEST(DiagnosticsTest, diagnosticBagBeginPointsToFirstDiagnostic)
 {
-    auto descriptor_a = make_custom_descriptor("message A");
-    auto descriptor_b = make_custom_descriptor("message B");
-
-    auto diag_a = build_diag(descriptor_a);
-    auto diag_b = build_diag(descriptor_b);
+    auto diag_a = DiagnosticBuilder<descriptor_a>().build();
+    auto diag_b = DiagnosticBuilder<descriptor_b>().build();
 
     auto bag = DiagnosticBag();
 
@@ -81,78 +100,89 @@ TEST_F(DiagnosticsTest, diagnosticBagBeginPointsToFirstDiagnostic)
 
     auto it = bag.begin();
 
-    EXPECT_EQ(build_diag(descriptor_a), *it);
-    EXPECT_NE(build_diag(descriptor_b), *it);
+    EXPECT_EQ(DiagnosticBuilder<descriptor_a>().build(), *it);
+    EXPECT_NE(DiagnosticBuilder<descriptor_b>().build(), *it);
 
     ++it;
 
-    EXPECT_NE(build_diag(descriptor_a), *it);
-    EXPECT_EQ(build_diag(descriptor_b), *it);
+    EXPECT_NE(DiagnosticBuilder<descriptor_a>().build(), *it);
+    EXPECT_EQ(DiagnosticBuilder<descriptor_b>().build(), *it);
 }
 
-TEST_F(DiagnosticsTest, builderWithDescriptor)
+TEST(DiagnosticsTest, builderWithDescriptor)
 {
-    auto custom_descriptor = make_descriptor();
-    auto diag = DiagnosticBuilder(custom_descriptor).build();
-    EXPECT_EQ(&custom_descriptor, diag.descriptor);
+    auto diag = DiagnosticBuilder<descriptor>().build();
+    EXPECT_EQ(&descriptor, diag.descriptor);
 }
 
-TEST_F(DiagnosticsTest, builderWithCarret)
+TEST(DiagnosticsTest, builderWithCarret)
 {
-    auto custom_descriptor = make_descriptor();
-    auto diag =
-        DiagnosticBuilder(custom_descriptor).caret_at(ByteLoc(42)).build();
+    auto diag = DiagnosticBuilder<descriptor>().caret_at(ByteLoc(42)).build();
 
-    EXPECT_EQ(&custom_descriptor, diag.descriptor);
+    EXPECT_EQ(&descriptor, diag.descriptor);
     EXPECT_EQ(ByteLoc(42), diag.caret_location);
 }
 
-TEST_F(DiagnosticsTest, builderWithSpans)
+TEST(DiagnosticsTest, builderWithSpans)
 {
-    auto custom_descriptor = make_descriptor();
-    auto diag = DiagnosticBuilder(custom_descriptor)
+    auto diag = DiagnosticBuilder<descriptor>()
                     .with_span(ByteSpan(ByteLoc(0), ByteLoc(3)))
                     .with_span(ByteSpan(ByteLoc(5), ByteLoc(10)))
                     .build();
 
-    EXPECT_EQ(&custom_descriptor, diag.descriptor);
+    EXPECT_EQ(&descriptor, diag.descriptor);
 
     ASSERT_EQ(2, diag.spans.size());
     EXPECT_EQ(ByteSpan(ByteLoc(0), ByteLoc(3)), diag.spans[0]);
     EXPECT_EQ(ByteSpan(ByteLoc(5), ByteLoc(10)), diag.spans[1]);
 }
 
-TEST_F(DiagnosticsTest, builderWithArgs)
+TEST(DiagnosticsTest, builderWithArgs)
 {
-    DiagnosticDescriptor descriptor{
-        .message = "a diagnostic description",
-        .params =
-            {
-                DiagnosticParam("a", DiagnosticParamKind::Int),
-                DiagnosticParam("b", DiagnosticParamKind::Str),
-                DiagnosticParam("c", DiagnosticParamKind::TokenKind),
-            },
-    };
-
-    auto diag = DiagnosticBuilder(descriptor)
+    auto diag = DiagnosticBuilder<descriptor_with_params>()
                     .with_arg("a", 42)
                     .with_arg("b", "foo")
                     .with_arg("c", TokenKind::comma)
                     .build();
 
-    EXPECT_EQ(&descriptor, diag.descriptor);
+    EXPECT_EQ(&descriptor_with_params, diag.descriptor);
+
+    EXPECT_EQ(DiagnosticArg(IntArg(42)), diag.args[0]);
+    EXPECT_EQ(DiagnosticArg(StrArg("foo")), diag.args[1]);
+    EXPECT_EQ(DiagnosticArg(TokenKindArg(TokenKind::comma)), diag.args[2]);
+    EXPECT_FALSE(diag.args[3].has_value());
+}
+
+TEST(DiagnosticsTest, builderStoresArgsInTheirParamSlot)
+{
+    auto diag = DiagnosticBuilder<descriptor_with_params>()
+                    .with_arg("c", TokenKind::semi)
+                    .with_arg("a", 7)
+                    .build();
+
+    EXPECT_EQ(DiagnosticArg(IntArg(7)), diag.args[0]);
+    EXPECT_FALSE(diag.args[1].has_value());
+    EXPECT_EQ(DiagnosticArg(TokenKindArg(TokenKind::semi)), diag.args[2]);
 
-    ASSERT_EQ(3, diag.args.size());
+    ASSERT_NE(nullptr, diag.get_arg("c"));
+    EXPECT_EQ(DiagnosticArg(TokenKindArg(TokenKind::semi)), *diag.get_arg("c"));
+    EXPECT_EQ(nullptr, diag.get_arg("b"));
+    EXPECT_EQ(nullptr, diag.get_arg("d"));
+}
 
-    EXPECT_EQ("a", diag.args[0].first);
-    EXPECT_EQ(DiagnosticArg(IntArg(42)), diag.args[0].second);
+TEST(DiagnosticsTest, strArgRefersToTheString)
+{
+    const std::string source = "int identifier;";
+    const std::string_view spelling = std::string_view(source).substr(4, 10);
 
-    EXPECT_EQ("b", diag.args[1].first);
-    EXPECT_EQ(DiagnosticArg(StrArg("foo")), diag.args[1].second);
+    auto diag = DiagnosticBuilder<descriptor_with_params>()
+                    .with_arg("b", spelling)
+                    .build();
 
-    EXPECT_EQ("c", diag.args[2].first);
-    EXPECT_EQ(DiagnosticArg(TokenKindArg(TokenKind::comma)),
-              diag.args[2].second);
+    const auto *arg = diag.args[1]->get_as<StrArg>();
+    ASSERT_NE(nullptr, arg);
+    EXPECT_EQ("identifier", arg->value);
+    EXPECT_EQ(source.data() + 4, arg->value.data());
 }
 
 } // namespace
@@ -0,0 +1,229 @@
+#include "cci/syntax/float_conversion.hpp"
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <utility>
+
+using cci::syntax::decimal_to_float;
+using cci::syntax::decimal_to_float_exact;
+using cci::syntax::hex_to_float;
+
+namespace {
+
+constexpr auto inf = std::numeric_limits<double>::infinity();
+
+// The decimal expansion of the halfway point between zero and the smallest
+// subnormal double, which is the hardest input for the decimal conversion.
+const std::string subnormal_halfway =
+    "0.0000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000000000000000000000000000000000000000"
+    "000000000000000000000000000000000000024703282292062327208828439643411068"
+    "618252990130716238221279284125033775363510437593264991818081799618989828"
+    "234772285886546332835517796989819938739800539093906315035659515570226392"
+    "290858392449105184435931802849936536152500319370457678249219365623669863"
+    "658480757001585769269903706311928279558551332927834338409351978015531246"
+    "597263579574622766465272827220056374006485499977096599470454020828166226"
+    "237857393450736339007967761930577506740176324673600968951340535537458516"
+    "661134223766678604162159680461914467291840300530057530849048765391711386"
+    "591646239524912623653881879636239373280423891018672348497668235089863388"
+    "587925628302755995657524455507255189313690836254779186948667994968324049"
+    "705821028513185451396213837722826145437693412532098591327667236328125";
+
+TEST(FloatConversionTest, decimalToDouble)
+{
+    EXPECT_EQ(std::pair(0.0, false), decimal_to_float<double>("0.0"));
+    EXPECT_EQ(std::pair(0.0, false), decimal_to_float<double>("e5"));
+    EXPECT_EQ(std::pair(1.0, false), decimal_to_float<double>("1."));
+    EXPECT_EQ(std::pair(0.5, false), decimal_to_float<double>(".5"));
+    EXPECT_EQ(std::pair(0.1, false), decimal_to_float<double>("0.1"));
+    EXPECT_EQ(std::pair(161.80e-3, false),
+              decimal_to_float<double>("161.80e-3"));
+    EXPECT_EQ(std::pair(6.02214076e23, false),
+              decimal_to_float<double>("6.02214076e23"));
+    EXPECT_EQ(std::pair(3.141592653589793, false),
+              decimal_to_float<double>("3.14159265358979323846264338327950"));
+    EXPECT_EQ(std::pair(123456789012345678901234567890.0, false),
+              decimal_to_float<double>("123456789012345678901234567890"));
+}
+
+TEST(FloatConversionTest, decimalToDoubleRoundsToEven)
+{
+    // 2^53 + 1 is halfway between 2^53 and 2^53 + 2.
+    EXPECT_EQ(9007199254740992.0,
+              decimal_to_float<double>("9007199254740993").first);
+    EXPECT_EQ(9007199254740996.0,
+              decimal_to_float<double>("9007199254740995").first);
+    EXPECT_EQ(9007199254740994.0,
+              decimal_to_float<double>("9007199254740993.0000000000001").first);
+}
+
+TEST(FloatConversionTest, decimalToDoubleLimits)
+{
+    constexpr auto limits = std::numeric_limits<double>();
+
+    EXPECT_EQ(std::pair(limits.max(), false),
+              decimal_to_float<double>("1.7976931348623157e308"));
+    EXPECT_EQ(std::pair(inf, true),
+              decimal_to_float<double>("1.7976931348623159e308"));
+    EXPECT_EQ(std::pair(inf, true), decimal_to_float<double>("1e309"));
+    EXPECT_EQ(std::pair(inf, true),
+              decimal_to_float<double>("1e99999999999999999999"));
+
+    EXPECT_EQ(std::pair(limits.min(), false),
+              decimal_to_float<double>("2.2250738585072014e-308"));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              decimal_to_float<double>("4.9406564584124654e-324"));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              decimal_to_float<double>("2.4703282292062328e-324"));
+    EXPECT_EQ(std::pair(0.0, false),
+              decimal_to_float<double>("2.4703282292062327e-324"));
+    EXPECT_EQ(std::pair(0.0, false), decimal_to_float<double>("1e-400"));
+    EXPECT_EQ(std::pair(0.0, false),
+              decimal_to_float<double>("1e-99999999999999999999"));
+
+    // Exactly halfway rounds to even, i.e. zero, but anything past it doesn't.
+    EXPECT_EQ(std::pair(0.0, false),
+              decimal_to_float<double>(subnormal_halfway));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              decimal_to_float<double>(subnormal_halfway + "1"));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              decimal_to_float<double>(subnormal_halfway +
+                                       std::string(5000, '0') + "1"));
+}
+
+TEST(FloatConversionTest, decimalToFloat)
+{
+    constexpr auto limits = std::numeric_limits<float>();
+
+    EXPECT_EQ(std::pair(0.1f, false), decimal_to_float<float>("0.1"));
+    EXPECT_EQ(std::pair(3.14f, false), decimal_to_float<float>("3.14"));
+    EXPECT_EQ(std::pair(limits.max(), false),
+              decimal_to_float<float>("3.4028235e38"));
+    EXPECT_EQ(std::pair(std::numeric_limits<float>::infinity(), true),
+              decimal_to_float<float>("3.4028236e38"));
+    EXPECT_EQ(std::pair(limits.min(), false),
+              decimal_to_float<float>("1.17549435e-38"));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              decimal_to_float<float>("1.4e-45"));
+    EXPECT_EQ(std::pair(0.0f, false), decimal_to_float<float>("7e-46"));
+
+    // Rounds once, straight from decimal. Rounding to double first would
+    // give 1.0f, as the nearest double is 1.000000059604644775390625, which
+    // is halfway between two floats.
+    EXPECT_EQ(1.00000012f,
+              decimal_to_float<float>("1.000000059604644775390626").first);
+    EXPECT_EQ(1.0f,
+              decimal_to_float<float>("1.000000059604644775390625").first);
+}
+
+TEST(FloatConversionTest, decimalToLongDouble)
+{
+    constexpr auto limits = std::numeric_limits<long double>();
+
+    EXPECT_EQ(std::pair(0.1L, false), decimal_to_float<long double>("0.1"));
+    EXPECT_EQ(std::pair(1e300L, false),
+              decimal_to_float<long double>("1e300"));
+    EXPECT_EQ(std::pair(2.5e-3L, false),
+              decimal_to_float<long double>("2.5e-3"));
+    EXPECT_EQ(std::pair(123456789012345678901234567890.0L, false),
+              decimal_to_float<long double>("123456789012345678901234567890"));
+    EXPECT_EQ(std::pair(limits.infinity(), true),
+              decimal_to_float<long double>("1e99999"));
+}
+
+TEST(FloatConversionTest, hexToFloat)
+{
+    constexpr auto limits = std::numeric_limits<double>();
+
+    EXPECT_EQ(std::pair(1.0, false), hex_to_float<double>("1p0"));
+    EXPECT_EQ(std::pair(12.0, false), hex_to_float<double>("1.8p3"));
+    EXPECT_EQ(std::pair(0.5, false), hex_to_float<double>(".8p0"));
+    EXPECT_EQ(std::pair(0.0, false), hex_to_float<double>("0.0p0"));
+    EXPECT_EQ(std::pair(255.0, false), hex_to_float<double>("ff.P0"));
+    EXPECT_EQ(std::pair(3.1415927f, false),
+              hex_to_float<float>("1.921fb6p+1"));
+
+    EXPECT_EQ(std::pair(limits.max(), false),
+              hex_to_float<double>("1.fffffffffffffp1023"));
+    EXPECT_EQ(std::pair(inf, true), hex_to_float<double>("1p1024"));
+    EXPECT_EQ(std::pair(inf, true),
+              hex_to_float<double>("1.fffffffffffff8p1023"));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              hex_to_float<double>("1p-1074"));
+    EXPECT_EQ(std::pair(0.0, false), hex_to_float<double>("1p-1075"));
+    EXPECT_EQ(std::pair(limits.denorm_min(), false),
+              hex_to_float<double>("1.00000000000000000000001p-1075"));
+
+    // Halfway between 1 and the next double, rounds to even.
+    EXPECT_EQ(1.0, hex_to_float<double>("1.00000000000008p0").first);
+    EXPECT_EQ(1.0000000000000004,
+              hex_to_float<double>("1.00000000000018p0").first);
+    EXPECT_EQ(1.0000000000000002,
+              hex_to_float<double>("1.000000000000080000000000001p0").first);
+}
+
+// Compares the conversions against the C library's, which are correctly
+// rounded too, on random constants of all sizes and exponents.
+TEST(FloatConversionTest, conversionsMatchStrtod)
+{
+    std::mt19937_64 rng(2024);
+    const auto below = [&](uint64_t n) { return rng() % n; };
+
+    for (int i = 0; i < 20'000; ++i)
+    {
+        const bool is_hex = below(4) == 0;
+        const char *const digit_chars =
+            is_hex ? "0123456789abcdef" : "0123456789";
+        const size_t num_digits = 1 + below(below(4) == 0 ? 60 : 20);
+        const size_t period = below(num_digits + 1);
+
+        std::string digits;
+        for (size_t d = 0; d < num_digits; ++d)
+        {
+            if (d == period)
+                digits += '.';
+            digits += digit_chars[below(is_hex ? 16 : 10)];
+        }
+
+        const int64_t exponent_range = is_hex ? 17000 : 400;
+        if (is_hex || below(2) == 0)
+        {
+            digits += is_hex ? 'p' : 'e';
+            digits += std::to_string(
+                static_cast<int64_t>(below(2 * exponent_range)) -
+                exponent_range);
+        }
+
+        const std::string source = is_hex ? "0x" + digits : digits;
+        const float expected_f = std::strtof(source.c_str(), nullptr);
+        const double expected_d = std::strtod(source.c_str(), nullptr);
+        const long double expected_ld = std::strtold(source.c_str(), nullptr);
+
+        if (is_hex)
+        {
+            EXPECT_EQ(expected_f, hex_to_float<float>(digits).first) << digits;
+            EXPECT_EQ(expected_d, hex_to_float<double>(digits).first) << digits;
+            EXPECT_EQ(expected_ld, hex_to_float<long double>(digits).first)
+                << digits;
+        }
+        else
+        {
+            EXPECT_EQ(expected_f, decimal_to_float<float>(digits).first)
+                << digits;
+            EXPECT_EQ(expected_d, decimal_to_float<double>(digits).first)
+                << digits;
+            EXPECT_EQ(expected_ld, decimal_to_float<long double>(digits).first)
+                << digits;
+            EXPECT_EQ(expected_d, decimal_to_float_exact<double>(digits).first)
+                << digits;
+        }
+    }
+}
+
+} // namespace
@@ -7,6 +7,9 @@
 #include "cci/util/span.hpp"
 #include "cci/util/unicode.hpp"
 #include "gtest/gtest.h"
+#include <cstdint>
+#include <limits>
+#include <random>
 #include <string>
 #include <string_view>
 
@@ -21,6 +24,7 @@ struct LiteralParserTest : cci::test::CompilerFixture
 protected:
     std::unique_ptr<Scanner> scanner;
     TargetInfo target;
+    small_string<32> spell_buffer;
 
     LiteralParserTest() : scanner(), target() {}
 
@@ -48,8 +52,9 @@ protected:
         auto lexed_toks = scan(std::move(source));
         EXPECT_EQ(1, lexed_toks.size());
         Token tok = lexed_toks.front();
-        NumericConstantParser parser(*this->scanner, get_lexeme_view(tok),
-                                     tok.location());
+        NumericConstantParser parser(
+            *this->scanner, scanner->get_spelling(tok, spell_buffer),
+            tok.location());
         return parser;
     }
 
@@ -59,7 +64,8 @@ protected:
         auto lexed_toks = scan(std::move(source));
         EXPECT_EQ(1, lexed_toks.size());
         Token tok = lexed_toks.front();
-        CharConstantParser parser(*this->scanner, get_lexeme_view(tok),
+        CharConstantParser parser(*this->scanner,
+                                  scanner->get_spelling(tok, spell_buffer),
                                   tok.location(), tok.kind, target);
         return parser;
     }
@@ -224,6 +230,135 @@ TEST_F(LiteralParserTest, numConstMissingExponentDigits)
     EXPECT_EQ(Diag::missing_exponent_digits, pop_diag().msg);
 }
 
+TEST_F(LiteralParserTest, numConstIntegerLimits)
+{
+    const std::pair<std::string, std::pair<uint64_t, bool>> cases[] = {
+        {"18446744073709551615", {UINT64_MAX, false}},
+        {"18446744073709551616", {0, true}},
+        {"99999999999999999999", {7766279631452241919ul, true}},
+        {"0xFFFFFFFFFFFFFFFF", {UINT64_MAX, false}},
+        {"0x10000000000000000", {0, true}},
+        {"0x000000000000000000000000abcdef01", {0xabcdef01, false}},
+        {"01777777777777777777777", {UINT64_MAX, false}},
+        {"02000000000000000000000", {0, true}},
+        {"12345678", {12345678, false}},
+        {"0x89aBcDeF", {0x89abcdef, false}},
+    };
+
+    for (const auto &[source, expected] : cases)
+    {
+        SCOPED_TRACE(source);
+        const auto parsed_num = parse_numeric_constant(source + '\n');
+        EXPECT_EQ(expected, parsed_num.to_integer());
+        EXPECT_EQ(expected, parsed_num.to_integer_scalar());
+    }
+}
+
+TEST_F(LiteralParserTest, numConstToIntegerMatchesScalar)
+{
+    std::mt19937_64 rng(2024);
+    const auto random_digits = [&](std::string_view alphabet, size_t size) {
+        std::string digits;
+        for (size_t i = 0; i < size; ++i)
+            digits += alphabet[rng() % alphabet.size()];
+        return digits;
+    };
+
+    for (int i = 0; i < 5'000; ++i)
+    {
+        const size_t num_digits = 1 + rng() % 40;
+        std::string source;
+        switch (i % 3)
+        {
+            case 0:
+                source = random_digits("123456789", 1) +
+                         random_digits("0123456789", num_digits - 1);
+                break;
+            case 1:
+                source = "0x" + random_digits("0123456789abcdefABCDEF0000",
+                                              num_digits);
+                break;
+            default:
+                source = "0" + random_digits("01234567", num_digits);
+                break;
+        }
+        SCOPED_TRACE(source);
+
+        const auto parsed_num = parse_numeric_constant(source + '\n');
+        ASSERT_FALSE(parsed_num.has_error);
+        ASSERT_EQ(parsed_num.to_integer_scalar(), parsed_num.to_integer());
+    }
+}
+
+TEST_F(LiteralParserTest, numConstFloatingValues)
+{
+    auto single = parse_numeric_constant("161.80e-3f");
+    EXPECT_FALSE(single.has_error);
+    EXPECT_TRUE(single.is_float);
+    EXPECT_EQ(std::pair(161.80e-3f, false), single.to_float());
+
+    auto hex = parse_numeric_constant("0x1.921fb54442d18p+1");
+    EXPECT_FALSE(hex.has_error);
+    EXPECT_EQ(16, hex.radix);
+    EXPECT_EQ(std::pair(3.141592653589793, false), hex.to_double());
+
+    auto leading_zero = parse_numeric_constant("017.5");
+    EXPECT_FALSE(leading_zero.has_error);
+    EXPECT_EQ(std::pair(17.5, false), leading_zero.to_double());
+
+    auto zero = parse_numeric_constant("0e0");
+    EXPECT_FALSE(zero.has_error);
+    EXPECT_EQ(std::pair(0.0, false), zero.to_double());
+
+    auto extended = parse_numeric_constant("1e-5L");
+    EXPECT_FALSE(extended.has_error);
+    EXPECT_TRUE(extended.is_long);
+    EXPECT_EQ(std::pair(1e-5L, false), extended.to_long_double());
+
+    auto too_large = parse_numeric_constant("1e39f");
+    EXPECT_FALSE(too_large.has_error);
+    EXPECT_EQ(std::pair(std::numeric_limits<float>::infinity(), true),
+              too_large.to_float());
+    EXPECT_EQ(std::pair(1e39, false), too_large.to_double());
+}
+
+// Lexemes are views into the source, so they're followed by whatever comes
+// next in it rather than by a null character.
+TEST_F(LiteralParserTest, numConstNotNullTerminated)
+{
+    const auto parse_prefix = [&](std::string source, size_t size) {
+        const Token tok = scan(std::move(source)).front();
+        const auto lexeme = scanner->get_spelling(tok, spell_buffer);
+        EXPECT_EQ(lexeme.data(), source_map.span_to_snippet(tok.source_span())
+                                     .data());
+        return NumericConstantParser(*scanner, lexeme.substr(0, size),
+                                     tok.location());
+    };
+
+    auto hex = parse_prefix("0x1f\n", 3);
+    EXPECT_FALSE(hex.has_error);
+    EXPECT_FALSE(hex.is_float);
+    EXPECT_EQ(std::pair(1ul, false), hex.to_integer());
+
+    auto long_int = parse_prefix("12ll\n", 3);
+    EXPECT_FALSE(long_int.has_error);
+    EXPECT_TRUE(long_int.is_long);
+    EXPECT_FALSE(long_int.is_long_long);
+
+    auto octal = parse_prefix("017.5\n", 3);
+    EXPECT_FALSE(octal.has_error);
+    EXPECT_EQ(8, octal.radix);
+    EXPECT_EQ(std::pair(15ul, false), octal.to_integer());
+
+    auto exponent = parse_prefix("1e5\n", 2);
+    EXPECT_TRUE(exponent.has_error);
+    EXPECT_EQ(Diag::missing_exponent_digits, pop_diag().msg);
+
+    auto binary_exponent = parse_prefix("0x1p+5\n", 5);
+    EXPECT_TRUE(binary_exponent.has_error);
+    EXPECT_EQ(Diag::missing_exponent_digits, pop_diag().msg);
+}
+
 TEST_F(LiteralParserTest, numConstDoubleHasPeriodNoLeftDigits)
 {
     auto parsed_num = parse_numeric_constant(".0");
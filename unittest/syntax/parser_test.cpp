@@ -8,9 +8,13 @@
 #include "cci/syntax/scanner.hpp"
 #include "cci/syntax/source_map.hpp"
 #include "gtest/gtest.h"
+#include <cmath>
 #include <memory>
 
 using cci::ast::ASTContext;
+using cci::ast::BuiltinType;
+using cci::ast::BuiltinTypeKind;
+using cci::ast::FloatingLiteral;
 using cci::ast::IntegerLiteral;
 using cci::diag::Diag;
 using cci::diag::Diagnostic;
@@ -49,6 +53,29 @@ TEST_F(ParserTest, integerLiteral)
     EXPECT_EQ(42, lit->value());
 }
 
+TEST_F(ParserTest, floatingLiteral)
+{
+    build_parser("1.5f\n");
+    const auto expr = parser->parse_expression().value();
+    const auto lit = expr->get_as<FloatingLiteral>();
+    ASSERT_TRUE(nullptr != lit);
+    EXPECT_EQ(1.5, lit->value());
+    EXPECT_EQ(BuiltinTypeKind::Float,
+              lit->type()->get_as<BuiltinType>()->builtin_kind());
+}
+
+TEST_F(ParserTest, floatingLiteralOverflow)
+{
+    build_parser("0x1p1024\n");
+    const auto expr = parser->parse_expression().value();
+    const auto lit = expr->get_as<FloatingLiteral>();
+    ASSERT_TRUE(nullptr != lit);
+    EXPECT_TRUE(std::isinf(lit->value()));
+    EXPECT_EQ(BuiltinTypeKind::Double,
+              lit->type()->get_as<BuiltinType>()->builtin_kind());
+    EXPECT_EQ(Diag::float_literal_overflow, pop_diag().msg);
+}
+
 TEST_F(ParserTest, unbalancedParens)
 {
     build_parser("(((42))+\n");
@@ -246,6 +246,31 @@ TEST_F(ScannerTest, keywords)
         expected_toks);
 }
 
+TEST_F(ScannerTest, identifiersResemblingKeywords)
+{
+    std::vector<std::pair<TokenKind, std::string>> expected_toks{
+        {TokenKind::identifier, "cafe"},    {TokenKind::identifier, "iff"},
+        {TokenKind::identifier, "Int"},     {TokenKind::identifier, "d"},
+        {TokenKind::identifier, "_Bools"},  {TokenKind::identifier, "whale"},
+        {TokenKind::identifier, "inline_"}, {TokenKind::identifier, "structs"},
+        {TokenKind::identifier, "_Static_assert_"},
+    };
+
+    check_lex("cafe iff Int d _Bools whale inline_ structs _Static_assert_\n",
+              expected_toks);
+}
+
+TEST_F(ScannerTest, dirtyKeywords)
+{
+    std::vector<std::pair<TokenKind, std::string>> expected_toks{
+        {TokenKind::kw_int, "int"},
+        {TokenKind::kw_return, "return"},
+        {TokenKind::identifier, "whilex"},
+    };
+
+    check_lex("in\\\nt ret\\\r\nurn whi\?\?/\nlex\n", expected_toks);
+}
+
 TEST_F(ScannerTest, numericConstants)
 {
     std::vector<std::pair<TokenKind, std::string>> expected_toks{
@@ -260,6 +285,25 @@ TEST_F(ScannerTest, numericConstants)
     check_lex("42ULL 3.14f 161.80e-3 1.9E377P+1 .999 0.\n", expected_toks);
 }
 
+// Signs are only part of a numeric constant right after an exponent letter,
+// which makes `0x1E-3` a single (invalid) preprocessing number.
+TEST_F(ScannerTest, numericConstantsFollowedBySigns)
+{
+    std::vector<std::pair<TokenKind, std::string>> expected_toks{
+        {TokenKind::numeric_constant, "1"},
+        {TokenKind::plus, "+"},
+        {TokenKind::numeric_constant, "2"},
+        {TokenKind::numeric_constant, "0x1E-3"},
+        {TokenKind::numeric_constant, "0x1F"},
+        {TokenKind::minus, "-"},
+        {TokenKind::numeric_constant, "3"},
+        {TokenKind::numeric_constant, "0x1E"},
+        {TokenKind::numeric_constant, "1e-2"},
+    };
+
+    check_lex("1+2 0x1E-3 0x1F-3 0x1E\n1e-2\n", expected_toks);
+}
+
 TEST_F(ScannerTest, comments)
 {
     std::vector<std::pair<TokenKind, std::string>> expected_toks{
@@ -300,6 +344,54 @@ m = n//**/o
         expected_toks);
 }
 
+TEST_F(ScannerTest, escapedNewlinesBeforeComments)
+{
+    std::vector<std::pair<TokenKind, std::string>> expected_toks{
+        {TokenKind::identifier, "a"},
+        {TokenKind::identifier, "b"},
+        {TokenKind::identifier, "c"},
+    };
+
+    // The escaped newlines belong to the comments, not to the tokens after
+    // them.
+    const auto toks =
+        check_lex("a\\\n/**/b\?\?/\n\\\n// comment\nc", expected_toks);
+    for (const Token &tok : toks)
+        EXPECT_FALSE(tok.is_dirty()) << get_lexeme(tok);
+}
+
+TEST_F(ScannerTest, longComments)
+{
+    std::vector<std::pair<TokenKind, std::string>> expected_toks{
+        {TokenKind::identifier, "a"}, {TokenKind::identifier, "b"},
+        {TokenKind::identifier, "c"}, {TokenKind::identifier, "d"},
+        {TokenKind::identifier, "e"}, {TokenKind::identifier, "f"},
+    };
+
+    const std::string filler(70, '-');
+    check_lex("/*" + filler + "*/ a\n"
+              "/*" + filler + "*\\\n/ b\n"
+              "/*" + filler + "*\?\?/\n/ c\n"
+              "/*" + filler + "/*/ d\n"
+              "//" + filler + "\\\n" + filler + "\n e\n"
+              "//" + filler + "\?\?/\n" + filler + "\n f // " + filler + "?\n",
+              expected_toks);
+}
+
+TEST_F(ScannerTest, unterminatedBlockComment)
+{
+    std::vector<std::pair<TokenKind, std::string>> expected_toks{
+        {TokenKind::identifier, "a"},
+    };
+
+    // The diagnostic is reported at the very end of the file.
+    check_lex("a /* never closed\n", expected_toks);
+    const auto d = pop_diag();
+    EXPECT_EQ(Diag::unterminated_comment, d.msg);
+    EXPECT_EQ(2, d.source_location().line);
+    EXPECT_EQ(cci::syntax::CharPos(0), d.source_location().column);
+}
+
 TEST_F(ScannerTest, charConstants)
 {
     std::vector<std::pair<TokenKind, std::string>> expected_toks{
@@ -338,6 +430,34 @@ TEST_F(ScannerTest, stringLiterals)
               expected_toks);
 }
 
+TEST_F(ScannerTest, hugeStringLiterals)
+{
+    // Tokens this long don't fit in a 16-bit length, which is all that a
+    // `TokenBuffer` keeps for most tokens.
+    const std::string huge = '"' + std::string(70'000, 'x') + '"';
+    const std::string source = "a " + huge + " b " + huge + "\n";
+    const auto toks = scan(source);
+
+    ASSERT_EQ(4, toks.size());
+    EXPECT_EQ(TokenKind::identifier, toks[0].kind);
+    EXPECT_EQ(TokenKind::string_literal, toks[1].kind);
+    EXPECT_EQ(huge.size(), toks[1].size());
+    EXPECT_EQ(huge, get_lexeme(toks[1]));
+    EXPECT_EQ(TokenKind::identifier, toks[2].kind);
+    EXPECT_EQ("b", get_lexeme(toks[2]));
+    EXPECT_EQ(huge, get_lexeme(toks[3]));
+
+    EXPECT_EQ(toks[1].location() + cci::syntax::ByteLoc(huge.size() + 1),
+              toks[2].location());
+    EXPECT_EQ(toks[1].source_span().end + cci::syntax::ByteLoc(1),
+              toks[2].location());
+
+    // Tokens rebuilt from a long span keep it.
+    const auto relexed = Token(toks[3].kind, toks[3].source_span());
+    EXPECT_EQ(toks[3].location(), relexed.location());
+    EXPECT_EQ(toks[3].size(), relexed.size());
+}
+
 TEST_F(ScannerTest, punctuators)
 {
     std::vector<std::pair<TokenKind, std::string>> expected_toks{
@@ -0,0 +1,146 @@
+#include "../temp_path.hpp"
+#include "cci/syntax/source_file_cache.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/util/file_stream.hpp"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace cci::syntax;
+
+namespace {
+
+struct SourceFileCacheTest : ::testing::Test
+{
+protected:
+    const fs::path dir =
+        cci::test::unique_temp_path("cci_source_file_cache_test");
+
+    SourceFileCacheTest() { fs::create_directories(dir); }
+    ~SourceFileCacheTest() override { fs::remove_all(dir); }
+
+    auto write_file(const std::string &name, std::string_view contents)
+        -> fs::path
+    {
+        const auto path = dir / name;
+        EXPECT_TRUE(cci::write_stream(
+            path, reinterpret_cast<const std::byte *>(contents.data()),
+            contents.size()));
+        return path;
+    }
+
+    // Bumps the modification time of a file without changing its contents.
+    void touch(const fs::path &path)
+    {
+        const auto mtime = fs::last_write_time(path);
+        fs::last_write_time(path, mtime + std::chrono::seconds(1));
+    }
+};
+
+TEST_F(SourceFileCacheTest, sharedAcrossSourceMaps)
+{
+    const auto header = write_file("header.h", "int x;\nint y;\n");
+    SourceFileCache cache;
+
+    SourceMap first;
+    first.create_owned_filemap("first.c", "#include \"header.h\"\n");
+    const FileMap &first_fm = first.add_filemap(cache.load(header));
+
+    SourceMap second;
+    const FileMap &second_fm = second.add_filemap(cache.load(header));
+
+    // Both maps share the contents, and the tables built by either of them,
+    // but place them at locations of their own.
+    EXPECT_EQ(&first_fm.source_file(), &second_fm.source_file());
+    EXPECT_EQ(1, cache.size());
+    EXPECT_NE(first_fm.start_loc, second_fm.start_loc);
+    EXPECT_EQ(ByteLoc(0), second_fm.start_loc);
+
+    const auto first_loc =
+        first.lookup_source_location(first_fm.start_loc + ByteLoc(9));
+    EXPECT_TRUE(second_fm.source_file().has_source_index());
+    const auto second_loc =
+        second.lookup_source_location(second_fm.start_loc + ByteLoc(9));
+
+    EXPECT_EQ(&first_fm, &first_loc.file);
+    EXPECT_EQ(&second_fm, &second_loc.file);
+    EXPECT_EQ(2, first_loc.line);
+    EXPECT_EQ(2, second_loc.line);
+    EXPECT_EQ(CharPos(2), first_loc.column);
+    EXPECT_EQ(CharPos(2), second_loc.column);
+    EXPECT_EQ("int y;\n", first_fm.get_line(1));
+}
+
+TEST_F(SourceFileCacheTest, reloadsChangedFiles)
+{
+    const auto path = write_file("changed.h", "int x;\n");
+    SourceFileCache cache;
+    const auto original = cache.load(path);
+
+    write_file("changed.h", "long x;\n");
+    touch(path);
+    const auto changed = cache.load(path);
+
+    ASSERT_NE(nullptr, changed);
+    EXPECT_NE(original, changed);
+    EXPECT_EQ("long x;\n", changed->src_view());
+    EXPECT_EQ("int x;\n", original->src_view());
+    EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(SourceFileCacheTest, comparesContentsOfTouchedFiles)
+{
+    const auto path = write_file("touched.h", "int x;\n");
+
+    SourceFileCache cache(/*compare_contents=*/true);
+    const auto original = cache.load(path);
+    touch(path);
+    EXPECT_EQ(original, cache.load(path));
+
+    SourceFileCache stamp_only_cache;
+    const auto stamp_only = stamp_only_cache.load(path);
+    touch(path);
+    EXPECT_NE(stamp_only, stamp_only_cache.load(path));
+}
+
+TEST_F(SourceFileCacheTest, equivalentPathsShareEntries)
+{
+    const auto path = write_file("same.h", "int x;\n");
+    SourceFileCache cache;
+
+    EXPECT_EQ(cache.load(path), cache.load(dir / "." / "same.h"));
+    EXPECT_EQ(1, cache.size());
+}
+
+TEST_F(SourceFileCacheTest, loadAll)
+{
+    std::vector<fs::path> paths;
+    for (int i = 0; i < 10; ++i)
+        paths.push_back(write_file("file" + std::to_string(i) + ".h",
+                                   "int x" + std::to_string(i) + ";\n"));
+    paths.push_back(dir / "missing.h");
+
+    SourceFileCache cache;
+    const auto cached = cache.load(paths[3]);
+    const auto files = cache.load_all(paths);
+
+    ASSERT_EQ(paths.size(), files.size());
+    EXPECT_EQ(cached, files[3]);
+    EXPECT_EQ(nullptr, files.back());
+    for (int i = 0; i < 10; ++i)
+    {
+        ASSERT_NE(nullptr, files[i]);
+        EXPECT_EQ("int x" + std::to_string(i) + ";\n", files[i]->src_view());
+    }
+    EXPECT_EQ(10, cache.size());
+    EXPECT_EQ(files, cache.load_all(paths));
+
+    cache.clear();
+    EXPECT_EQ(0, cache.size());
+    EXPECT_EQ("int x3;\n", cached->src_view());
+}
+
+} // namespace
@@ -1,5 +1,15 @@
+#include "../temp_path.hpp"
 #include "cci/syntax/source_map.hpp"
+#include "cci/util/file_stream.hpp"
+#include "cci/util/unicode.hpp"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace cci::syntax;
 
@@ -41,10 +51,36 @@ TEST_F(SourceMapTest, lookupFileMapIndex)
     EXPECT_EQ(1, source_map.lookup_filemap_idx(ByteLoc(12)));
     EXPECT_EQ(2, source_map.lookup_filemap_idx(ByteLoc(13)));
 
+    // End locations are part of the file map, e.g. for diagnostics at the end
+    // of input.
+    EXPECT_EQ(0, source_map.lookup_filemap_idx(ByteLoc(11)));
+    EXPECT_EQ(2, source_map.lookup_filemap_idx(ByteLoc(47)));
+
+    EXPECT_THROW(source_map.lookup_filemap_idx(ByteLoc(48)),
+                 cci::broken_contract);
     EXPECT_THROW(source_map.lookup_filemap_idx(ByteLoc(500)),
                  cci::broken_contract);
 }
 
+TEST_F(SourceMapTest, lookupFileMapIndexManyFiles)
+{
+    SourceMap many_source_map;
+    std::vector<const FileMap *> files;
+    for (int i = 0; i < 1000; ++i)
+        files.push_back(&many_source_map.create_owned_filemap(
+            "file" + std::to_string(i) + ".c",
+            std::string(static_cast<size_t>(i % 7), 'x')));
+
+    // Looks up files out of order so that the last file cache misses.
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        const size_t idx = (i * 389) % files.size();
+        const FileMap &fm = *files[idx];
+        EXPECT_EQ(idx, many_source_map.lookup_filemap_idx(fm.start_loc));
+        EXPECT_EQ(idx, many_source_map.lookup_filemap_idx(fm.end_loc));
+    }
+}
+
 TEST_F(SourceMapTest, lookupLine)
 {
     const auto [fm1, line1] = source_map.lookup_line(ByteLoc(10));
@@ -179,6 +215,76 @@ TEST_F(SourceMapTest, multiByteCharByteLocToCharPos)
                  cci::broken_contract);
 }
 
+TEST_F(SourceMapTest, multiByteCharByteLocToCharPosMixedSizes)
+{
+    // Characters of 1, 2, 3 and 4 bytes: "a", "é", "中" and "😀".
+    SourceMap map;
+    const auto &fm = map.create_owned_filemap(
+        "mixed.c", "aé中\U0001F600b中\n");
+
+    EXPECT_EQ(CharPos(0), fm.byteloc_to_charpos(ByteLoc(0)));
+    EXPECT_EQ(CharPos(1), fm.byteloc_to_charpos(ByteLoc(1)));
+    EXPECT_EQ(CharPos(2), fm.byteloc_to_charpos(ByteLoc(3)));
+    EXPECT_EQ(CharPos(3), fm.byteloc_to_charpos(ByteLoc(6)));
+    EXPECT_EQ(CharPos(4), fm.byteloc_to_charpos(ByteLoc(10)));
+    EXPECT_EQ(CharPos(5), fm.byteloc_to_charpos(ByteLoc(11)));
+    EXPECT_EQ(CharPos(6), fm.byteloc_to_charpos(ByteLoc(14)));
+    EXPECT_EQ(CharPos(7), fm.byteloc_to_charpos(ByteLoc(15)));
+
+    EXPECT_THROW(fm.byteloc_to_charpos(ByteLoc(8)), cci::broken_contract);
+    EXPECT_THROW(fm.byteloc_to_charpos(ByteLoc(13)), cci::broken_contract);
+}
+
+TEST_F(SourceMapTest, lineAndMultiByteTablesMatchByteWalk)
+{
+    // Mixes ASCII, newlines, and valid and malformed UTF-8 (including lead
+    // bytes that swallow a newline), then checks the tables against a plain
+    // walk over every byte.
+    std::mt19937 gen(1234);
+    const std::string_view pieces[] = {"a",    "\n",   "é",       "中",
+                                       "😀",   " ",    "\x80",    "\xE4",
+                                       "\xF0\n", "b\n"};
+    std::uniform_int_distribution<size_t> dist(0, std::size(pieces) - 1);
+
+    for (int round = 0; round < 50; ++round)
+    {
+        std::string source;
+        for (int i = 0; i < 200; ++i)
+            source += pieces[dist(gen)];
+
+        SourceMap map;
+        map.create_owned_filemap("first.c", "int x;\n");
+        const auto &fm = map.create_owned_filemap("random.c", source);
+
+        // The tables are in offsets from the start of the file, wherever it's
+        // placed in the source map.
+        std::vector<ByteLoc> lines{ByteLoc(0)};
+        std::vector<std::pair<ByteLoc, size_t>> mbcs;
+        const std::string_view src = fm.src_view();
+        for (size_t i = 0; i < src.size();)
+        {
+            const ByteLoc loc = ByteLoc(i);
+            if (static_cast<unsigned char>(src[i]) < 0x80)
+            {
+                if (src[i] == '\n')
+                    lines.push_back(loc + ByteLoc(1));
+                ++i;
+                continue;
+            }
+            const auto lead = static_cast<cci::uni::UTF8>(src[i]);
+            const size_t bytes =
+                std::min(cci::uni::num_bytes_for_utf8(lead), src.size() - i);
+            mbcs.emplace_back(loc, bytes);
+            i += bytes;
+        }
+
+        EXPECT_EQ(lines, fm.source_file().lines()) << "round: " << round;
+        EXPECT_EQ(mbcs, fm.source_file().multibyte_chars())
+            << "round: " << round;
+        EXPECT_EQ(mbcs.size(), fm.source_file().multibyte_extra_bytes().size());
+    }
+}
+
 TEST_F(SourceMapTest, multiByteCharlookupSourceLocation)
 {
     const auto loc1 = mbc_source_map.lookup_source_location(ByteLoc(0));
@@ -197,4 +303,259 @@ TEST_F(SourceMapTest, multiByteCharlookupSourceLocation)
     EXPECT_EQ(CharPos(2), loc3.column);
 }
 
+TEST_F(SourceMapTest, sourceIndexIsBuiltOnFirstLookup)
+{
+    const auto &fm = source_map.create_owned_filemap("lazy.c", "a\nb\nc\n");
+    EXPECT_FALSE(fm.source_file().has_source_index());
+
+    // Resolving files and byte locations doesn't need the index.
+    EXPECT_EQ(&fm, &source_map.lookup_filemap(fm.start_loc));
+    EXPECT_EQ(fm.start_loc + ByteLoc(2),
+              source_map.ptr_to_byteloc(fm.start_loc, fm.src_begin() + 2));
+    EXPECT_FALSE(fm.source_file().has_source_index());
+
+    EXPECT_EQ(1, fm.lookup_line_idx(fm.start_loc + ByteLoc(2)));
+    EXPECT_TRUE(fm.source_file().has_source_index());
+    EXPECT_EQ(4, fm.source_file().lines().size());
+}
+
+TEST_F(SourceMapTest, concurrentFirstLookups)
+{
+    std::string src;
+    for (int i = 0; i < 1'000; ++i)
+        src += "line \xce\xb1\xce\xb2 " + std::to_string(i) + "\n";
+    const auto &fm = source_map.create_owned_filemap("shared.c", src);
+    EXPECT_FALSE(fm.source_file().has_source_index());
+
+    std::vector<size_t> lines(8);
+    {
+        std::vector<std::jthread> threads;
+        for (size_t t = 0; t < lines.size(); ++t)
+            threads.emplace_back([&, t] {
+                const ByteLoc loc = fm.start_loc + ByteLoc(src.size() - 2);
+                lines[t] = source_map.lookup_source_location(loc).line;
+            });
+    }
+
+    for (const size_t line : lines)
+        EXPECT_EQ(1'000, line);
+    EXPECT_EQ(1'000, fm.source_file().multibyte_chars().size() / 2);
+}
+
+TEST_F(SourceMapTest, batchLookupMatchesSingleLookups)
+{
+    // Locations at the start of every character of a few files, with and
+    // without multibyte characters, in the same source map as empty files.
+    std::vector<ByteLoc> locs;
+    for (const char *src : {"int a;\n\xce\xb1 = \xce\xb2;\n\n// \xe6\x97\xa5\n",
+                            "", "x\ny\nz", "\xf0\x9f\x98\x80\xce\xb1\n"})
+    {
+        const auto &fm = source_map.create_owned_filemap("batch.c", src);
+        const auto text = fm.src_view();
+        for (size_t i = 0; i <= text.size(); ++i)
+        {
+            if (i == text.size() || (text[i] & 0xC0) != 0x80)
+                locs.push_back(fm.start_loc + ByteLoc(i));
+        }
+    }
+
+    const auto check = [&](const std::vector<ByteLoc> &locs) {
+        const auto source_locs = source_map.lookup_source_locations(locs);
+        ASSERT_EQ(locs.size(), source_locs.size());
+        for (size_t i = 0; i < locs.size(); ++i)
+        {
+            const auto expected = source_map.lookup_source_location(locs[i]);
+            EXPECT_EQ(&expected.file, &source_locs[i].file);
+            EXPECT_EQ(expected.line, source_locs[i].line);
+            EXPECT_EQ(expected.column, source_locs[i].column);
+        }
+    };
+
+    check(locs);
+    std::mt19937 rng(42);
+    std::shuffle(locs.begin(), locs.end(), rng);
+    check(locs);
+    const std::vector<ByteLoc> repeated(locs.begin(), locs.begin() + 10);
+    locs.insert(locs.end(), repeated.begin(), repeated.end());
+    check(locs);
+    check({});
+}
+
+// Checks that loading `contents` from a file gives the same source as an owned
+// file map does, and that it's followed by the null character the scanner
+// relies on. Only files of at least `min_mapped_size` bytes are mapped.
+void check_load_filemap(const std::string &contents)
+{
+    const auto path = cci::test::unique_temp_path("cci_load_filemap_test");
+    ASSERT_TRUE(cci::write_stream(
+        path, reinterpret_cast<const std::byte *>(contents.data()),
+        contents.size()));
+
+    SourceMap source_map;
+    const FileMap *mapped = source_map.load_filemap(path);
+    const FileMap &owned = source_map.create_owned_filemap("owned.c", contents);
+    fs::remove(path);
+
+    ASSERT_NE(nullptr, mapped);
+    EXPECT_EQ(contents.size() >= SourceMap::min_mapped_size,
+              mapped->source_file().is_mapped());
+    EXPECT_FALSE(owned.source_file().is_mapped());
+    EXPECT_EQ(path.string(), mapped->name);
+    EXPECT_EQ(owned.src_view(), mapped->src_view());
+    EXPECT_EQ('\0', *mapped->src_end());
+    EXPECT_EQ(owned.source_file().lines(), mapped->source_file().lines());
+}
+
+TEST_F(SourceMapTest, loadFileMap)
+{
+    check_load_filemap("");
+    check_load_filemap("int x;\n");
+    check_load_filemap("int x;");
+    check_load_filemap("\xef\xbb\xbf");
+    check_load_filemap("\xef\xbb\xbfint x;");
+
+    // Files filling whole pages have nothing past their end in the mapping
+    // of the file itself.
+    for (const size_t size : {4096, 16384, 65536})
+    {
+        check_load_filemap(std::string(size - 1, 'x') + "\n");
+        check_load_filemap(std::string(size, 'x'));
+    }
+
+    // Files are only mapped from `min_mapped_size` bytes on.
+    for (const size_t size :
+         {SourceMap::min_mapped_size - 1, SourceMap::min_mapped_size})
+        check_load_filemap(std::string(size, 'x'));
+}
+
+TEST_F(SourceMapTest, loadFileMapMissingFile)
+{
+    SourceMap source_map;
+    EXPECT_EQ(nullptr, source_map.load_filemap(fs::temp_directory_path() /
+                                                "cci_does_not_exist.c"));
+}
+
+// Loads a batch of files, some of them missing, and checks that they're
+// loaded in order, just as if they were loaded one by one.
+void check_load_filemaps(cci::BatchReadBackend backend)
+{
+    const auto dir = cci::test::unique_temp_path("cci_load_filemaps_test");
+    fs::create_directories(dir);
+
+    std::vector<fs::path> paths;
+    std::vector<std::string> sources;
+    for (size_t i = 0; i < 300; ++i)
+    {
+        // Exceeds the number of reads in flight at a time, and has files
+        // larger than any single read buffer would likely be.
+        std::string src;
+        for (size_t j = 0; j < (i % 7) * (i % 11) * 40; ++j)
+            src += "int x" + std::to_string(j) + "; // αβγ\n";
+        if (i % 5 == 0)
+            src += "int no_newline;";
+        paths.push_back(dir / ("file" + std::to_string(i) + ".c"));
+        if (i % 13 == 12)
+            continue; // Missing file.
+        ASSERT_TRUE(cci::write_stream(
+            paths.back(), reinterpret_cast<const std::byte *>(src.data()),
+            src.size()));
+        sources.push_back(std::move(src));
+    }
+
+    SourceMap expected_map;
+    SourceMap source_map;
+    const auto filemaps = source_map.load_filemaps(paths, backend);
+    fs::remove_all(dir);
+
+    ASSERT_EQ(paths.size(), filemaps.size());
+    size_t next_source = 0;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        SCOPED_TRACE(i);
+        if (i % 13 == 12)
+        {
+            EXPECT_EQ(nullptr, filemaps[i]);
+            continue;
+        }
+        ASSERT_NE(nullptr, filemaps[i]);
+        const FileMap &expected = expected_map.create_owned_filemap(
+            paths[i].string(), sources[next_source++]);
+        EXPECT_EQ(expected.name, filemaps[i]->name);
+        EXPECT_EQ(expected.start_loc, filemaps[i]->start_loc);
+        EXPECT_EQ(expected.end_loc, filemaps[i]->end_loc);
+        EXPECT_EQ(expected.src_view(), filemaps[i]->src_view());
+        EXPECT_EQ(expected.source_file().lines(),
+                  filemaps[i]->source_file().lines());
+    }
+}
+
+TEST_F(SourceMapTest, loadFileMaps)
+{
+    check_load_filemaps(cci::BatchReadBackend::automatic);
+}
+
+TEST_F(SourceMapTest, loadFileMapsWithThreadPool)
+{
+    check_load_filemaps(cci::BatchReadBackend::thread_pool);
+}
+
+TEST_F(SourceMapTest, loadFileMapsEmptyBatch)
+{
+    SourceMap source_map;
+    EXPECT_TRUE(source_map.load_filemaps({}).empty());
+}
+
+TEST_F(SourceMapTest, updateLastFileMapInPlace)
+{
+    SourceMap source_map;
+    source_map.create_owned_filemap("first.c", "int x;\n");
+    const FileMap &file = source_map.create_owned_filemap("main.c", "a\nb\n");
+    const ByteLoc start_loc = file.start_loc;
+    const std::weak_ptr<const SourceFile> old_source =
+        file.shared_source_file();
+
+    // Many more edits than would fit if each took up new locations.
+    for (int i = 0; i < 10'000; ++i)
+    {
+        const FileMap &updated = source_map.update_filemap(file, {2, 1, "cc"});
+        EXPECT_EQ(&file, &updated);
+        source_map.update_filemap(file, {2, 2, "b"});
+    }
+    EXPECT_TRUE(old_source.expired());
+
+    const FileMap &updated = source_map.update_filemap(file, {4, 0, "long\n"});
+    EXPECT_EQ(&file, &updated);
+    EXPECT_EQ("main.c", updated.name);
+    EXPECT_EQ("a\nb\nlong\n", updated.src_view());
+    EXPECT_EQ(start_loc, updated.start_loc);
+    EXPECT_EQ(start_loc + ByteLoc(9), updated.end_loc);
+
+    // Lines are those of the new source.
+    const auto loc =
+        source_map.lookup_source_location(start_loc + ByteLoc(6));
+    EXPECT_EQ(&updated, &loc.file);
+    EXPECT_EQ(3, loc.line);
+    EXPECT_EQ(CharPos(2), loc.column);
+}
+
+TEST_F(SourceMapTest, updateEarlierFileMapMovesIt)
+{
+    SourceMap source_map;
+    const FileMap &file = source_map.create_owned_filemap("main.c", "a\nb\n");
+    const FileMap &other = source_map.create_owned_filemap("other.c", "x");
+    const std::weak_ptr<const SourceFile> old_source =
+        file.shared_source_file();
+
+    const FileMap &moved = source_map.update_filemap(file, {0, 1, "aa"});
+    EXPECT_NE(&file, &moved);
+    EXPECT_TRUE(old_source.expired());
+    EXPECT_EQ("main.c", moved.name);
+    EXPECT_EQ("aa\nb\n", moved.src_view());
+    EXPECT_LT(other.end_loc, moved.start_loc);
+    EXPECT_EQ(&moved, &source_map.lookup_filemap(moved.start_loc));
+
+    // From then on, it's the last file map and stays put.
+    EXPECT_EQ(&moved, &source_map.update_filemap(moved, {0, 2, ""}));
+}
+
 } // namespace
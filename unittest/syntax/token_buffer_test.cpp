@@ -0,0 +1,387 @@
+#include "../compiler_fixture.hpp"
+#include "cci/syntax/scanner.hpp"
+#include "cci/syntax/source_map.hpp"
+#include "cci/syntax/token.hpp"
+#include "cci/syntax/token_buffer.hpp"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+using cci::syntax::ByteSpan;
+using cci::syntax::Scanner;
+using cci::syntax::SourceEdit;
+using cci::syntax::Token;
+using cci::syntax::TokenBuffer;
+using cci::syntax::TokenCursor;
+using cci::syntax::TokenKind;
+
+namespace {
+
+struct TokenBufferTest : cci::test::CompilerFixture
+{
+protected:
+    auto scan(const cci::syntax::FileMap &file) -> std::vector<Token>
+    {
+        Scanner scanner(file, diag_handler);
+        std::vector<Token> toks;
+        for (Token tok = scanner.next_token(); tok.is_not(TokenKind::eof);
+             tok = scanner.next_token())
+            toks.push_back(tok);
+        return toks;
+    }
+
+    void expect_same_token(const Token &expected, const Token &actual)
+    {
+        EXPECT_EQ(expected.kind, actual.kind);
+        EXPECT_EQ(expected.source_span(), actual.source_span());
+        EXPECT_EQ(expected.flag_bits(), actual.flag_bits());
+    }
+
+    using DiagInfo = std::tuple<cci::diag::Diag, size_t, size_t>;
+
+    auto drain_diags() -> std::vector<DiagInfo>
+    {
+        std::vector<DiagInfo> infos;
+        while (!diags.empty())
+        {
+            const auto d = pop_diag();
+            const auto loc = d.source_location();
+            infos.emplace_back(d.msg, static_cast<size_t>(loc.line),
+                               static_cast<size_t>(loc.column));
+        }
+        return infos;
+    }
+
+    // Checks that lexing `file` in parallel yields the same tokens and the
+    // same diagnostics as lexing it sequentially, for several chunk counts.
+    void check_lex_parallel(const cci::syntax::FileMap &file)
+    {
+        const auto expected = TokenBuffer::lex(file, diag_handler);
+        const auto expected_diags = drain_diags();
+
+        for (const size_t num_chunks : {2, 3, 7, 16, 64, 256})
+        {
+            SCOPED_TRACE(num_chunks);
+            const auto tokens =
+                TokenBuffer::lex_parallel(file, diag_handler, num_chunks);
+            EXPECT_EQ(expected_diags, drain_diags());
+            ASSERT_EQ(expected.size(), tokens.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                SCOPED_TRACE(i);
+                expect_same_token(expected[i], tokens[i]);
+            }
+        }
+    }
+
+    // Applies `edit` to `file` and relexes `tokens`, checking that they end
+    // up the same as lexing the edited file from scratch.
+    auto check_relex(const cci::syntax::FileMap &file, TokenBuffer &tokens,
+                     const cci::syntax::SourceEdit &edit)
+        -> std::pair<const cci::syntax::FileMap &, TokenBuffer::RelexedRange>
+    {
+        const auto &edited = source_map.create_edited_filemap(file, edit);
+        const auto relexed = tokens.relex(edited, edit, diag_handler);
+        const auto expected = TokenBuffer::lex(edited, diag_handler);
+        drain_diags();
+
+        EXPECT_EQ(expected.size(), tokens.size());
+        for (size_t i = 0; i < std::min(expected.size(), tokens.size()); ++i)
+        {
+            SCOPED_TRACE(i);
+            expect_same_token(expected[i], tokens[i]);
+        }
+        return {edited, relexed};
+    }
+};
+
+TEST_F(TokenBufferTest, emptyFile)
+{
+    const auto &file = create_filemap("empty.c", "");
+    const auto tokens = TokenBuffer::lex(file, diag_handler);
+
+    EXPECT_TRUE(tokens.empty());
+    EXPECT_EQ(TokenKind::eof, tokens[0].kind);
+    EXPECT_EQ(ByteSpan(), tokens[0].source_span());
+}
+
+TEST_F(TokenBufferTest, matchesScannerTokens)
+{
+    create_filemap("first.c", "int first;\n");
+    const auto &file = create_filemap(
+        "second.c", "int main(void) { return u8\"str\" [0] + L'x'; }\n"
+                    "/* comment */ fo\\\no \\u00C0 1.5e+3f \?\?= 'a\n");
+
+    const auto expected = scan(file);
+    const auto tokens = TokenBuffer::lex(file, diag_handler);
+
+    ASSERT_EQ(expected.size(), tokens.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        SCOPED_TRACE(i);
+        expect_same_token(expected[i], tokens[i]);
+        EXPECT_EQ(expected[i].kind, tokens.kind(i));
+    }
+    EXPECT_EQ(TokenKind::eof, tokens[tokens.size()].kind);
+
+    // Both runs report the unterminated character constant.
+    pop_diag();
+    pop_diag();
+}
+
+TEST_F(TokenBufferTest, lexRemainingStartsWhereScannerStopped)
+{
+    const auto &file = create_filemap("main.c", "a b c\n");
+    Scanner scanner(file, diag_handler);
+    scanner.next_token();
+
+    const auto tokens = TokenBuffer::lex_remaining(scanner);
+
+    ASSERT_EQ(2, tokens.size());
+    EXPECT_EQ("b", get_source_text(tokens[0]));
+    EXPECT_EQ("c", get_source_text(tokens[1]));
+}
+
+TEST_F(TokenBufferTest, cursorLookahead)
+{
+    const auto &file = create_filemap("main.c", "a + b\n");
+    const auto tokens = TokenBuffer::lex(file, diag_handler);
+    TokenCursor cursor(tokens);
+
+    EXPECT_EQ(TokenKind::identifier, cursor.peek_kind());
+    EXPECT_EQ(TokenKind::plus, cursor.peek(1).kind);
+    EXPECT_EQ(TokenKind::identifier, cursor.peek(2).kind);
+    EXPECT_EQ(TokenKind::eof, cursor.peek(3).kind);
+    EXPECT_EQ(TokenKind::eof, cursor.peek(100).kind);
+
+    EXPECT_EQ("a", get_source_text(cursor.consume()));
+    EXPECT_EQ("+", get_source_text(cursor.consume()));
+    EXPECT_EQ("b", get_source_text(cursor.consume()));
+    EXPECT_EQ(3, cursor.position());
+
+    EXPECT_EQ(TokenKind::eof, cursor.consume().kind);
+    EXPECT_EQ(TokenKind::eof, cursor.consume().kind);
+    EXPECT_EQ(3, cursor.position());
+}
+
+TEST_F(TokenBufferTest, lexParallelSplitsOnlyAtLines)
+{
+    const auto &file = create_filemap("main.c", "int a; int b; int c;");
+    const auto tokens = TokenBuffer::lex_parallel(file, diag_handler, 8);
+
+    ASSERT_EQ(9, tokens.size());
+    EXPECT_EQ("c", get_source_text(tokens[7]));
+}
+
+// Chunk boundaries are guessed at line starts, so this puts lines inside of
+// comments and literals that don't look like it.
+TEST_F(TokenBufferTest, lexParallelMatchesLexOnWrongGuesses)
+{
+    std::string source;
+    for (int i = 0; i < 100; ++i)
+    {
+        source += "/*\n"
+                  "block comment without leading stars, with 'quotes\n"
+                  "int not_a_declaration = 'x';\n"
+                  "*/\n"
+                  "char *s = \"a string \\\n"
+                  "spanning lines\";\n"
+                  "int y = a \?\?/\n"
+                  "+ b;\n"
+                  "// line comment \\\n"
+                  "continued */ x = 1;\n";
+        source += "int f" + std::to_string(i) + "(void) { return " +
+                  std::to_string(i) + "; }\n";
+        if (i % 10 == 0)
+            source += "char c = 'unterminated;\n\\u00C0 @\n";
+    }
+    const auto &file = create_filemap("main.c", std::move(source));
+
+    check_lex_parallel(file);
+}
+
+TEST_F(TokenBufferTest, lexParallelMatchesLexOnTestCorpus)
+{
+    namespace fs = std::filesystem;
+    size_t num_files = 0;
+
+    for (const auto &entry : fs::directory_iterator(CCI_SYNTAX_TEST_DIR))
+    {
+        if (entry.path().extension() != ".cpp")
+            continue;
+        SCOPED_TRACE(entry.path().string());
+
+        std::ifstream in(entry.path(), std::ios::binary);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        const auto &file =
+            create_filemap(entry.path().string(), contents.str());
+
+        check_lex_parallel(file);
+        ++num_files;
+    }
+
+    EXPECT_LT(0, num_files);
+}
+
+TEST_F(TokenBufferTest, relexOnlyAroundEdit)
+{
+    const auto &file = create_filemap("main.c", "int a = 1;\n"
+                                                "int b = 2;\n"
+                                                "int c = 3;\n");
+    auto tokens = TokenBuffer::lex(file, diag_handler);
+
+    const auto [edited, relexed] = check_relex(file, tokens, {15, 1, "bee"});
+    EXPECT_EQ("main.c", edited.name);
+    EXPECT_EQ(4, relexed.first);
+    EXPECT_EQ(3, relexed.num_removed);
+    EXPECT_EQ(3, relexed.num_inserted);
+    EXPECT_EQ("bee", get_source_text(tokens[6]));
+    EXPECT_EQ("c", get_source_text(tokens[11]));
+}
+
+TEST_F(TokenBufferTest, relexTokensChangedByEdit)
+{
+    const auto &file = create_filemap("main.c", "x = a .. b; y = c / d; */\n"
+                                                "\"unterminated\n"
+                                                "z;\n");
+    auto tokens = TokenBuffer::lex(file, diag_handler);
+    drain_diags();
+
+    // Joins two periods into an ellipsis.
+    const auto [file1, r1] = check_relex(file, tokens, {8, 0, "."});
+    // Opens a comment that ends at the end of the line.
+    const auto [file2, r2] = check_relex(file1, tokens, {20, 0, "*"});
+    // Closes the string literal on the next line.
+    const auto [file3, r3] = check_relex(file2, tokens, {42, 0, "\""});
+    // Edits before the first token.
+    const auto [file4, r4] = check_relex(file3, tokens, {0, 0, "/**/ w"});
+    EXPECT_EQ(0, r4.first);
+    // Removes everything.
+    check_relex(file4, tokens, {0, file4.src_view().size(), ""});
+    EXPECT_TRUE(tokens.empty());
+}
+
+TEST_F(TokenBufferTest, relexLooksBackThroughEscapedNewlines)
+{
+    const auto &file = create_filemap("main.c", "x..\\\n\\\ny;\n"
+                                                "a %:\?\?/\n\\\r\n% b;\n");
+    auto tokens = TokenBuffer::lex(file, diag_handler);
+
+    // The scanner looked past both escaped newlines after the periods to see
+    // whether they form an ellipsis, and now they do.
+    const auto [file1, r1] = check_relex(file, tokens, {7, 0, "."});
+    EXPECT_EQ(0, r1.first);
+    EXPECT_EQ(TokenKind::ellipsis, tokens[1].kind);
+    // Likewise for a digraph that's completed three escaped newlines later.
+    const auto [file2, r2] = check_relex(file1, tokens, {23, 0, ":"});
+    EXPECT_EQ(3, r2.first);
+    EXPECT_EQ(TokenKind::hashhash, tokens[5].kind);
+}
+
+TEST_F(TokenBufferTest, relexFileMapUpdatedInPlace)
+{
+    const auto &file = create_filemap("main.c", "int a = 1;\n"
+                                                "int b = 2;\n");
+    auto tokens = TokenBuffer::lex(file, diag_handler);
+
+    const cci::syntax::SourceEdit edits[] = {
+        {4, 1, "alpha"}, {13, 0, " + 2"}, {0, 0, "long "}, {32, 1, "9"}};
+    for (const auto &edit : edits)
+    {
+        const auto &updated = source_map.update_filemap(file, edit);
+        EXPECT_EQ(&file, &updated);
+        tokens.relex(updated, edit, diag_handler);
+        const auto expected = TokenBuffer::lex(updated, diag_handler);
+
+        ASSERT_EQ(expected.size(), tokens.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            SCOPED_TRACE(i);
+            expect_same_token(expected[i], tokens[i]);
+        }
+    }
+    EXPECT_EQ("long int alpha = 1 + 2;\nint b = 9;\n", file.src_view());
+}
+
+TEST_F(TokenBufferTest, longTokens)
+{
+    // Lengths of tokens this long are kept on the side, and must follow the
+    // tokens through stitching chunks and splicing in relexed tokens.
+    const std::string huge = '"' + std::string(70'000, 'x') + '"';
+    const auto &file = create_filemap("main.c", "a = " + huge + ";\nb = " +
+                                                    huge + ";\nc;\n");
+    const auto tokens = TokenBuffer::lex(file, diag_handler);
+    const auto expected = scan(file);
+    ASSERT_EQ(expected.size(), tokens.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        SCOPED_TRACE(i);
+        expect_same_token(expected[i], tokens[i]);
+    }
+    EXPECT_EQ(huge, get_source_text(tokens[2]));
+    EXPECT_EQ(huge, get_source_text(tokens[6]));
+    check_lex_parallel(file);
+
+    auto relexed = tokens;
+    // Edits before the second literal, into it, then replaces the first one
+    // and adds another one in front.
+    const auto [file1, r1] = check_relex(file, relexed, {0, 1, "alpha"});
+    const auto [file2, r2] = check_relex(file1, relexed, {70'030, 0, "y"});
+    EXPECT_EQ(3, r2.first);
+    const auto [file3, r3] = check_relex(file2, relexed, {8, 70'002, "0"});
+    EXPECT_EQ(0, r3.first);
+    check_relex(file3, relexed, {0, 0, huge + ";\n"});
+    EXPECT_EQ(huge, get_source_text(relexed[0]));
+    EXPECT_EQ(70'003, relexed[8].size());
+}
+
+TEST_F(TokenBufferTest, relexMatchesLexOnRandomEdits)
+{
+    std::string source;
+    for (int i = 0; i < 20; ++i)
+    {
+        source += "/* comment */ int f" + std::to_string(i) +
+                  "(int a) { return a <<= 1 + 'c' + sizeof \"s\\\n\"; }\n"
+                  "// line \\\ncomment\n"
+                  "float g = 1.5e+3f; x->y ... %:%: \?\?/\n\n"
+                  "z = .\\\n\?\?/\n.\\\r\n\\\n. %:\\\n%\\\n\\\n: .\\\n.;\n";
+    }
+    const cci::syntax::FileMap *file =
+        &create_filemap("main.c", std::move(source));
+    auto tokens = TokenBuffer::lex(*file, diag_handler);
+    drain_diags();
+
+    const std::string_view replacements[] = {
+        "", "x", " ", "\n", "\"", "'", "/*", "*/", "//", "\\\n",
+        "\?\?/", ".", ":", "%", "<", "=", "1", "e+", "u8\"", "foo bar",
+        "\\\n\\\n", "\\\r\n", "\r", "..", "%:",
+    };
+    std::mt19937 rng(42);
+
+    for (int i = 0; i < 500; ++i)
+    {
+        const size_t size = file->src_view().size();
+        const size_t offset =
+            std::uniform_int_distribution<size_t>(0, size)(rng);
+        const size_t removed = std::uniform_int_distribution<size_t>(
+            0, std::min<size_t>(4, size - offset))(rng);
+        const auto replacement = replacements[std::uniform_int_distribution<
+            size_t>(0, std::size(replacements) - 1)(rng)];
+        SCOPED_TRACE(i);
+
+        file = &check_relex(*file, tokens, {offset, removed, replacement})
+                    .first;
+        if (HasFailure())
+            break;
+    }
+}
+
+} // namespace
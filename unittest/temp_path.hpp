@@ -0,0 +1,28 @@
+#pragma once
+
+#include "cci/util/filesystem.hpp"
+#include "gtest/gtest.h"
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+namespace cci::test {
+
+/// Returns a path in the temporary directory that no other test uses, not
+/// even the same test run by another process, as `ctest -j` does.
+inline auto unique_temp_path(std::string_view prefix) -> fs::path
+{
+    const auto *info = ::testing::UnitTest::GetInstance()->current_test_info();
+    std::string name(prefix);
+    if (info)
+    {
+        name += '_';
+        name += info->test_suite_name();
+        name += '_';
+        name += info->name();
+    }
+    name += '_' + std::to_string(::getpid());
+    return fs::temp_directory_path() / name;
+}
+
+} // namespace cci::test